@@ -0,0 +1,75 @@
+/* Implements the small harness shared by the benchmarks in this directory. Each benchmark is a
+plain program that times a few closures with `seconds_per_call`, and prints one line per closure
+with `report_throughput` (in GB/s) or `report_time` (in nanoseconds per item). Every closure is
+repeated until it has run for at least `MIN_SECONDS`, several times over, and the fastest
+repetition is reported, which filters out most of the noise from other processes. */
+
+#pragma once
+
+#include <algorithm>        // For `std::min`
+#include <chrono>           // For `std::chrono::steady_clock`
+#include <cstddef>          // For `std::size_t`
+#include <cstdio>           // For `std::printf`
+#include <cstdlib>          // For `std::strtoull`
+#include <string_view>      // For `std::string_view`
+
+namespace bench {
+
+/* `MIN_SECONDS` is the minimum duration of one repetition, and `REPETITIONS` the number of
+repetitions, of which the fastest is reported. */
+constexpr double MIN_SECONDS = 0.05;
+constexpr unsigned REPETITIONS = 5;
+
+/* Prevents the compiler from optimizing away the computation of `value`. */
+template <typename T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T *sink;
+    sink = &value;
+#endif
+}
+
+/* Returns the number of seconds one call to `func()` takes, as measured by the fastest of
+`REPETITIONS` repetitions of at least `MIN_SECONDS` each. */
+template <typename Func>
+double seconds_per_call(Func &&func) {
+    using Clock = std::chrono::steady_clock;
+    func();  /* Warms up the caches and the branch predictors. */
+
+    double best = 1e300;
+    for (unsigned repetition = 0; repetition < REPETITIONS; ++repetition) {
+        std::size_t calls = 0;
+        auto start = Clock::now();
+        double elapsed = 0;
+        do {
+            func();
+            ++calls;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < MIN_SECONDS);
+        best = std::min(best, elapsed / static_cast<double>(calls));
+    }
+    return best;
+}
+
+/* Prints the throughput of a call taking `seconds` to process `bytes` bytes. */
+inline void report_throughput(std::string_view name, double seconds, double bytes) {
+    std::printf("%-48.*s %10.3f GB/s\n", static_cast<int>(name.size()), name.data(),
+                bytes / seconds / 1e9);
+}
+
+/* Prints the time per item of a call taking `seconds` to process `items` items. */
+inline void report_time(std::string_view name, double seconds, double items) {
+    std::printf("%-48.*s %10.3f ns/item\n", static_cast<int>(name.size()), name.data(),
+                seconds / items * 1e9);
+}
+
+/* Returns the first command-line argument, parsed as a number, or `default_value` if there is
+none. Benchmarks use it as their problem size. */
+inline std::size_t size_argument(int argc, char **argv, std::size_t default_value) {
+    return argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10))
+                    : default_value;
+}
+
+};  /* Ending bracket for `namespace bench` */
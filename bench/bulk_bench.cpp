@@ -0,0 +1,57 @@
+/* Measures the throughput of `extract_tags` and `tag_histogram` (see tagged_pointer_bulk.h) with
+every kernel this CPU supports, against a loop over `tag()`, on an array of `TaggedPointer`s
+(by default 16M elements, or the number given as the first argument). Throughput is in GB/s of
+`TaggedPointer`s read. */
+
+#include <cstdint>          // For `uint8_t`
+#include <random>           // For `std::mt19937_64`
+#include <string>           // For `std::string`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer_bulk.h"
+#include "bench.h"
+
+struct A {int a;};
+struct B {int b;};
+struct C {int c;};
+struct D {int d;};
+using Pointer = TaggedPointer<A, B, C, D>;
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 24);
+
+    A a; B b; C c; D d;
+    std::vector<Pointer> ptrs(n);
+    std::mt19937_64 rng(42);
+    for (auto &ptr : ptrs) {
+        switch (rng() % 4) {
+            case 0: ptr = &a; break;
+            case 1: ptr = &b; break;
+            case 2: ptr = &c; break;
+            default: ptr = &d; break;
+        }
+    }
+    std::span<const Pointer> span(ptrs);
+    std::vector<uint8_t> tags(n);
+    auto bytes = static_cast<double>(n * sizeof(Pointer));
+
+    bench::report_throughput("extract_tags: loop over tag()", bench::seconds_per_call([&] {
+        for (std::size_t i = 0; i < n; ++i) {tags[i] = static_cast<uint8_t>(ptrs[i].tag());}
+        bench::do_not_optimize(tags.data());
+    }), bytes);
+    bench::report_throughput("tag_histogram: loop over tag()", bench::seconds_per_call([&] {
+        std::size_t counts[Pointer::num_types() + 1] = {};
+        for (auto &ptr : ptrs) {++counts[ptr.tag()];}
+        bench::do_not_optimize(counts);
+    }), bytes);
+
+    for_each_bulk_isa([&](BulkIsa isa) {
+        std::string suffix = std::string(" (") + bulk_isa_name(isa) + ")";
+        bench::report_throughput("extract_tags" + suffix, bench::seconds_per_call([&] {
+            extract_tags(span, tags.data());
+            bench::do_not_optimize(tags.data());
+        }), bytes);
+        bench::report_throughput("tag_histogram" + suffix, bench::seconds_per_call([&] {
+            bench::do_not_optimize(tag_histogram(span));
+        }), bytes);
+    });
+}
@@ -0,0 +1,54 @@
+/* Measures the time per element of `call_all` with three functions, which dispatches once, against
+three separate `call`s, which dispatch three times, in a loop over an array of `TaggedPointer`s
+with random types (by default 1M elements, or the number given as the first argument, small
+enough to stay in cache so that the dispatches dominate). */
+
+#include <random>           // For `std::mt19937_64`
+#include <tuple>            // For `std::get`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer.h"
+#include "bench.h"
+
+struct A {int x, y, z;};
+struct B {int x, y, z;};
+struct C {int x, y, z;};
+struct D {int x, y, z;};
+using Pointer = TaggedPointer<A, B, C, D>;
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 20);
+
+    A a{1, 2, 3}; B b{4, 5, 6}; C c{7, 8, 9}; D d{10, 11, 12};
+    std::vector<Pointer> ptrs(n);
+    std::mt19937_64 rng(42);
+    for (auto &ptr : ptrs) {
+        switch (rng() % 4) {
+            case 0: ptr = &a; break;
+            case 1: ptr = &b; break;
+            case 2: ptr = &c; break;
+            default: ptr = &d; break;
+        }
+    }
+    auto items = static_cast<double>(n);
+
+    bench::report_time("three separate calls", bench::seconds_per_call([&] {
+        int sum = 0;
+        for (auto &ptr : ptrs) {
+            sum += ptr.call([](auto p) {return p->x;});
+            sum ^= ptr.call([](auto p) {return p->y;});
+            sum += ptr.call([](auto p) {return p->z;});
+        }
+        bench::do_not_optimize(sum);
+    }), items);
+    bench::report_time("call_all with three functions", bench::seconds_per_call([&] {
+        int sum = 0;
+        for (auto &ptr : ptrs) {
+            auto results = ptr.call_all([](auto p) {return p->x;}, [](auto p) {return p->y;},
+                                        [](auto p) {return p->z;});
+            sum += std::get<0>(results);
+            sum ^= std::get<1>(results);
+            sum += std::get<2>(results);
+        }
+        bench::do_not_optimize(sum);
+    }), items);
+}
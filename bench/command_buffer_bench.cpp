@@ -0,0 +1,113 @@
+/* Measures the time per operation of recording operations into a `CommandBuffer` (see
+command_buffer.h) and then flushing it, with `flush` and with `flush_in_order`, against dispatching
+each operation immediately with `call`, on operations issued on objects of 8 types in random order.
+By default 1M operations are issued, or the number given as the first argument. Two mixes of
+operations are measured: a single operation, and two operations issued in random order, which
+`flush_in_order` replays one command at a time.
+
+Each mix is measured on two sets of types. In `Flat<I>`, every type has the same layout, so the
+arms of the immediate dispatch compile to the same code, which the compiler merges: there is then
+no dispatch left to save, and calling immediately wins. In `Body<I>`, the `I`th type has `I + 1`
+dimensions, so every arm differs, and the immediate dispatch mispredicts on most operations, which
+grouping the commands avoids. */
+
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../command_buffer.h"
+#include "bench.h"
+
+/* `Flat<I>` is the `I`th of the types operated on in the first set: a point on a line. */
+template <std::size_t I>
+struct Flat {
+    constexpr static std::size_t DIMENSIONS = 1;
+    double position[1], velocity[1];
+};
+
+/* `Body<I>` is the `I`th of the types operated on in the second set: a point in `I + 1`
+dimensions. */
+template <std::size_t I>
+struct Body {
+    constexpr static std::size_t DIMENSIONS = I + 1;
+    double position[I + 1], velocity[I + 1];
+};
+
+struct Advance {
+    template <typename T>
+    static void apply(T *body, double dt) {
+        for (std::size_t d = 0; d < T::DIMENSIONS; ++d) {
+            body->position[d] += body->velocity[d] * dt;
+        }
+    }
+};
+
+struct Damp {
+    template <typename T>
+    static void apply(T *body, double factor) {
+        for (std::size_t d = 0; d < T::DIMENSIONS; ++d) {body->velocity[d] *= factor;}
+    }
+};
+
+template <template <std::size_t> typename Type, std::size_t... Is>
+void run(const char *types, std::size_t n, std::index_sequence<Is...>) {
+    using Pointer = TaggedPointer<Type<Is>...>;
+    constexpr auto N = sizeof...(Is);
+    constexpr std::size_t OBJECTS_PER_TYPE = 1024;
+
+    std::tuple<std::vector<Type<Is>>...> bodies{std::vector<Type<Is>>(OBJECTS_PER_TYPE)...};
+    std::vector<Pointer> objects;
+    (..., [&] {for (auto &body : std::get<Is>(bodies)) {objects.emplace_back(&body);}}());
+
+    for (bool mixed : {false, true}) {
+        std::mt19937_64 rng(42);
+        std::vector<Pointer> targets(n);
+        std::vector<bool> damps(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            targets[i] = objects[rng() % (N * OBJECTS_PER_TYPE)];
+            damps[i] = mixed && rng() % 2 == 0;
+        }
+        auto items = static_cast<double>(n);
+        const char *mix = mixed ? "Advance and Damp" : "Advance";
+        char name[64];
+
+        std::snprintf(name, sizeof(name), "%s, %s: immediate call", types, mix);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            for (std::size_t i = 0; i < n; ++i) {
+                if (damps[i]) {
+                    targets[i].call([](auto body) {Damp::apply(body, 0.999);});
+                } else {
+                    targets[i].call([](auto body) {Advance::apply(body, 0.001);});
+                }
+            }
+        }), items);
+
+        CommandBuffer<Pointer, Advance, Damp> commands;
+        auto record = [&] {
+            for (std::size_t i = 0; i < n; ++i) {
+                if (damps[i]) {
+                    commands.template record<Damp>(targets[i], 0.999);
+                } else {
+                    commands.template record<Advance>(targets[i], 0.001);
+                }
+            }
+        };
+        std::snprintf(name, sizeof(name), "%s, %s: record and flush", types, mix);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            record();
+            commands.flush();
+        }), items);
+        std::snprintf(name, sizeof(name), "%s, %s: record and flush_in_order", types, mix);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            record();
+            commands.flush_in_order();
+        }), items);
+    }
+}
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 20);
+    run<Flat>("Flat", n, std::make_index_sequence<8>{});
+    run<Body>("Body", n, std::make_index_sequence<8>{});
+}
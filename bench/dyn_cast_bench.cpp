@@ -0,0 +1,74 @@
+/* Measures the time per element of `dyn_cast<Base>()`, which adds an offset looked up by tag to the
+stored pointer, against the idiom it replaces, `call` with a function returning the pointer upcast
+to a `Base*` (or `nullptr`), in a loop over an array of `TaggedPointer`s to 8 types, 6 of which are
+derived from `Base`, at 3 different offsets. By default there are 1M elements, or the number given
+as the first argument, small enough to stay in cache. The types come either in random order, or
+cycling through the 8 types, which the branch predictor learns. */
+
+#include <random>           // For `std::mt19937_64`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <type_traits>      // For `std::is_base_of_v`, `std::remove_pointer_t`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer.h"
+#include "bench.h"
+
+struct Base {int value;};
+struct Small {int small;};
+struct Padding {long padding[2];};
+
+/* `Type<I>` is the `I`th of the types pointed to: types with `I % 4 == 3` are not derived from
+`Base`, and the others have their `Base` subobject at an offset of 0, 16 or 4 bytes. */
+template <std::size_t I>
+struct Type;
+template <std::size_t I> requires (I % 4 == 0)
+struct Type<I> : Base {int extra;};
+template <std::size_t I> requires (I % 4 == 1)
+struct Type<I> : Padding, Base {};
+template <std::size_t I> requires (I % 4 == 2)
+struct Type<I> : Small, Base {};
+template <std::size_t I> requires (I % 4 == 3)
+struct Type<I> {int value;};
+
+template <typename Pointer, typename Upcast>
+void run(const char *name, const std::vector<Pointer> &ptrs, Upcast upcast) {
+    bench::report_time(name, bench::seconds_per_call([&] {
+        int sum = 0;
+        for (auto &ptr : ptrs) {
+            if (Base *base = upcast(ptr)) {sum += base->value;}
+        }
+        bench::do_not_optimize(sum);
+    }), static_cast<double>(ptrs.size()));
+}
+
+template <std::size_t... Is>
+void run_all(std::size_t n, std::index_sequence<Is...>) {
+    using Pointer = TaggedPointer<Type<Is>...>;
+    constexpr auto N = sizeof...(Is);
+
+    std::tuple<Type<Is>...> objects;
+    Pointer choices[] = {Pointer(&std::get<Is>(objects))...};
+
+    for (bool random : {true, false}) {
+        std::vector<Pointer> ptrs(n);
+        std::mt19937_64 rng(42);
+        for (std::size_t i = 0; i < n; ++i) {ptrs[i] = choices[random ? rng() % N : i % N];}
+
+        run(random ? "random: call returning Base*" : "cycling: call returning Base*", ptrs,
+            [](Pointer ptr) {
+                return ptr.call([](auto p) -> Base* {
+                    if constexpr (std::is_base_of_v<Base, std::remove_pointer_t<decltype(p)>>) {
+                        return p;
+                    } else {
+                        return nullptr;
+                    }
+                });
+            });
+        run(random ? "random: dyn_cast<Base>" : "cycling: dyn_cast<Base>", ptrs,
+            [](Pointer ptr) {return ptr.template dyn_cast<Base>();});
+    }
+}
+
+int main(int argc, char **argv) {
+    run_all(bench::size_argument(argc, argv, std::size_t{1} << 20), std::make_index_sequence<8>{});
+}
@@ -0,0 +1,60 @@
+/* Measures the time per element of `call(hot<T>{}, func)`, which compares the tag with that of `T`
+before dispatching, against plain `call`, in a loop over an array of `TaggedPointer`s to 8 types,
+where a share of the elements ranging from 1/8 (uniform) to 99% point to the hot type, and the
+rest to the other types at random. By default there are 1M elements, or the number given as the
+first argument, small enough to stay in cache so that the dispatches dominate. */
+
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`, `std::uniform_real_distribution`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer.h"
+#include "bench.h"
+
+/* `Type<I>` is the `I`th of the types pointed to; `Type<0>` is the hot one. */
+template <std::size_t I>
+struct Type {int value;};
+
+/* Returns a value computed differently for each type. It is never inlined, as is typical of the
+functions dispatched to, so that the arms of the dispatch cannot be merged into one. */
+template <std::size_t I>
+[[gnu::noinline]] int work(const Type<I> *p) {return p->value * static_cast<int>(2 * I + 3) + 1;}
+
+template <std::size_t... Is>
+void run(std::size_t n, std::index_sequence<Is...>) {
+    using Pointer = TaggedPointer<Type<Is>...>;
+    constexpr auto N = sizeof...(Is);
+
+    std::tuple<Type<Is>...> objects{Type<Is>{static_cast<int>(Is)}...};
+    Pointer choices[] = {Pointer(&std::get<Is>(objects))...};
+    auto func = [](auto p) {return work(p);};
+
+    for (double hot_share : {1.0 / N, 0.5, 0.8, 0.95, 0.99}) {
+        std::vector<Pointer> ptrs(n);
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> uniform;
+        for (auto &ptr : ptrs) {
+            ptr = uniform(rng) < hot_share ? choices[0] : choices[1 + rng() % (N - 1)];
+        }
+        auto items = static_cast<double>(n);
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "%4.1f%% hot: call", hot_share * 100);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            int sum = 0;
+            for (auto &ptr : ptrs) {sum += ptr.call(func);}
+            bench::do_not_optimize(sum);
+        }), items);
+        std::snprintf(name, sizeof(name), "%4.1f%% hot: call(hot<Type<0>>{})", hot_share * 100);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            int sum = 0;
+            for (auto &ptr : ptrs) {sum += ptr.call(hot<Type<0>>{}, func);}
+            bench::do_not_optimize(sum);
+        }), items);
+    }
+}
+
+int main(int argc, char **argv) {
+    run(bench::size_argument(argc, argv, std::size_t{1} << 20), std::make_index_sequence<8>{});
+}
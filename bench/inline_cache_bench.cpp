@@ -0,0 +1,69 @@
+/* Measures the time per element of `InlineCache::call` (see inline_cache.h) against plain `call`,
+and against `call(hot<Type<0>>{})`, which needs the hot type to be known at compile-time, in a
+loop over an array of `TaggedPointer`s to 8 types. In the first workload, 99.9% of the elements
+point to the same type, so the cache becomes monomorphic; in the second, the types are uniformly
+distributed, so the cache becomes megamorphic, and should cost little more than `call`. By default
+there are 1M elements, or the number given as the first argument, small enough to stay in cache. */
+
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`, `std::uniform_real_distribution`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../inline_cache.h"
+#include "bench.h"
+
+/* `Type<I>` is the `I`th of the types pointed to; `Type<0>` is the one that dominates. */
+template <std::size_t I>
+struct Type {int value;};
+
+/* Returns a value computed differently for each type. It is never inlined, as is typical of the
+functions dispatched to, so that the arms of the dispatch cannot be merged into one. */
+template <std::size_t I>
+[[gnu::noinline]] int work(const Type<I> *p) {return p->value * static_cast<int>(2 * I + 3) + 1;}
+
+template <std::size_t... Is>
+void run(std::size_t n, std::index_sequence<Is...>) {
+    using Pointer = TaggedPointer<Type<Is>...>;
+    constexpr auto N = sizeof...(Is);
+
+    std::tuple<Type<Is>...> objects{Type<Is>{static_cast<int>(Is)}...};
+    Pointer choices[] = {Pointer(&std::get<Is>(objects))...};
+    auto func = [](auto p) {return work(p);};
+
+    for (double hot_share : {0.999, 1.0 / N}) {
+        std::vector<Pointer> ptrs(n);
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> uniform;
+        for (auto &ptr : ptrs) {
+            ptr = uniform(rng) < hot_share ? choices[0] : choices[1 + rng() % (N - 1)];
+        }
+        auto items = static_cast<double>(n);
+        const char *workload = hot_share > 0.5 ? "99.9% one type" : "uniform";
+        char name[64];
+
+        std::snprintf(name, sizeof(name), "%s: call", workload);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            int sum = 0;
+            for (auto &ptr : ptrs) {sum += ptr.call(func);}
+            bench::do_not_optimize(sum);
+        }), items);
+        std::snprintf(name, sizeof(name), "%s: call(hot<Type<0>>{})", workload);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            int sum = 0;
+            for (auto &ptr : ptrs) {sum += ptr.call(hot<Type<0>>{}, func);}
+            bench::do_not_optimize(sum);
+        }), items);
+        InlineCache<Pointer> cache;
+        std::snprintf(name, sizeof(name), "%s: InlineCache::call", workload);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            int sum = 0;
+            for (auto &ptr : ptrs) {sum += cache.call(ptr, func);}
+            bench::do_not_optimize(sum);
+        }), items);
+    }
+}
+
+int main(int argc, char **argv) {
+    run(bench::size_argument(argc, argv, std::size_t{1} << 20), std::make_index_sequence<8>{});
+}
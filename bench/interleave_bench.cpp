@@ -0,0 +1,93 @@
+/* Measures the time per lookup of `run_interleaved` (see tagged_pointer_interleave.h) for a range
+of widths, against the same lookups run one after the other by a plain loop, in a binary tree of
+`TaggedPointer`s whose nodes are laid out in random order. By default the tree has 8M leaves (about
+200 MB of nodes, larger than the last-level cache of most CPUs), so that every level of each
+lookup misses the cache; pass another number of leaves (rounded up to a power of two) as the first
+argument. */
+
+#include <algorithm>        // For `std::shuffle`
+#include <cstdint>          // For `uint64_t`
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`
+#include <utility>          // For `std::move`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer_interleave.h"
+#include "bench.h"
+
+struct Inner;
+struct Leaf {long value;};
+using Node = TaggedPointer<Inner, Leaf>;
+struct Inner {Node children[2];};
+
+/* Returns the leaf at the end of the path given by the bits of `key`, from the lowest up. */
+const Leaf *find_leaf(Node node, uint64_t key) {
+    while (!node.points_to_type<Leaf>()) {
+        node = node.cast_unchecked<Inner>()->children[key & 1];
+        key >>= 1;
+    }
+    return node.cast_unchecked<Leaf>();
+}
+
+/* Same as `find_leaf`, but suspends before following each pointer. */
+InterleavedTask<const Leaf*> find_leaf_interleaved(Node node, uint64_t key) {
+    while (!node.points_to_type<Leaf>()) {
+        node = node.cast_unchecked<Inner>()->children[key & 1];
+        key >>= 1;
+        co_await prefetch_and_yield(node);
+    }
+    co_return node.cast_unchecked<Leaf>();
+}
+
+int main(int argc, char **argv) {
+    auto num_leaves = bench::size_argument(argc, argv, std::size_t{1} << 23);
+    unsigned depth = 0;
+    while ((std::size_t{1} << depth) < num_leaves) {++depth;}
+    num_leaves = std::size_t{1} << depth;
+    std::mt19937_64 rng(42);
+
+    /* Builds the tree level by level, from the leaves up, from nodes taken in random order. */
+    std::vector<Leaf> leaves(num_leaves);
+    std::vector<Inner> inners(num_leaves);
+    std::vector<std::size_t> order(num_leaves);
+    for (std::size_t i = 0; i < num_leaves; ++i) {order[i] = i;}
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<Node> level;
+    for (std::size_t i = 0; i < num_leaves; ++i) {
+        leaves[order[i]].value = static_cast<long>(i);
+        level.emplace_back(&leaves[order[i]]);
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    std::size_t next_inner = 0;
+    while (level.size() > 1) {
+        std::vector<Node> parents;
+        for (std::size_t i = 0; i < level.size(); i += 2) {
+            auto &inner = inners[order[next_inner++]];
+            inner.children[0] = level[i];
+            inner.children[1] = level[i + 1];
+            parents.emplace_back(&inner);
+        }
+        level = std::move(parents);
+    }
+    Node root = level[0];
+
+    constexpr std::size_t NUM_LOOKUPS = 1 << 16;
+    std::vector<uint64_t> keys(NUM_LOOKUPS);
+    for (auto &key : keys) {key = rng();}
+
+    bench::report_time("sequential find_leaf", bench::seconds_per_call([&] {
+        long sum = 0;
+        for (auto key : keys) {sum += find_leaf(root, key)->value;}
+        bench::do_not_optimize(sum);
+    }), NUM_LOOKUPS);
+    for (std::size_t width : {1, 2, 4, 8, 16, 32}) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "run_interleaved, width %zu", width);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            long sum = 0;
+            run_interleaved(NUM_LOOKUPS, [&](std::size_t i) {
+                return find_leaf_interleaved(root, keys[i]);
+            }, [&](std::size_t, const Leaf *leaf) {sum += leaf->value;}, width);
+            bench::do_not_optimize(sum);
+        }), NUM_LOOKUPS);
+    }
+}
@@ -0,0 +1,64 @@
+/* Measures the time per pair of `dispatch` (see multiple_dispatch.h), which makes one indirect call
+through a table of `N * N` entries, against a `call` nested inside another, which makes two
+dependent dispatches, for `N` types from 3 to 16, on pairs of `TaggedPointer`s with random types
+(by default 1M pairs, or the number given as the first argument, small enough to stay in cache so
+that the dispatches dominate). */
+
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../multiple_dispatch.h"
+#include "bench.h"
+
+/* `Type<I>` is the `I`th of the types pointed to. */
+template <std::size_t I>
+struct Type {int value;};
+
+/* Returns a value depending on both types, so that every pair of types needs its own code. */
+template <std::size_t I, std::size_t J>
+int combine(const Type<I> *a, const Type<J> *b) {return a->value * static_cast<int>(J) + b->value;}
+
+template <std::size_t... Is>
+void run(std::size_t n, std::index_sequence<Is...>) {
+    constexpr auto N = sizeof...(Is);
+    using Pointer = TaggedPointer<Type<Is>...>;
+
+    std::tuple<Type<Is>...> objects{Type<Is>{static_cast<int>(Is)}...};
+    Pointer choices[] = {Pointer(&std::get<Is>(objects))...};
+    std::vector<Pointer> as(n), bs(n);
+    std::mt19937_64 rng(42);
+    for (std::size_t i = 0; i < n; ++i) {
+        as[i] = choices[rng() % N];
+        bs[i] = choices[rng() % N];
+    }
+    auto func = [](auto *a, auto *b) {return combine(a, b);};
+    auto items = static_cast<double>(n);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "%zux%zu: nested call", N, N);
+    bench::report_time(name, bench::seconds_per_call([&] {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const Pointer &b = bs[i];
+            sum += as[i].call([&](auto *a) {return b.call([&](auto *b) {return func(a, b);});});
+        }
+        bench::do_not_optimize(sum);
+    }), items);
+    std::snprintf(name, sizeof(name), "%zux%zu: dispatch", N, N);
+    bench::report_time(name, bench::seconds_per_call([&] {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += dispatch(func, std::as_const(as[i]), std::as_const(bs[i]));
+        }
+        bench::do_not_optimize(sum);
+    }), items);
+}
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 20);
+    run(n, std::make_index_sequence<3>{});
+    run(n, std::make_index_sequence<4>{});
+    run(n, std::make_index_sequence<8>{});
+    run(n, std::make_index_sequence<16>{});
+}
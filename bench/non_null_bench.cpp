@@ -0,0 +1,60 @@
+/* Measures the time per `call` of a `NonNullTaggedPointer`, which dispatches on `tag()` directly,
+against that of a `TaggedPointer` to the same objects, which dispatches on `tag() - 1`, in a loop
+over an array of pointers to 8 types (by default 1M elements, or the number given as the first
+argument, small enough to stay in cache so that the dispatch itself dominates). The types come
+either in random order, where branch mispredictions dominate, or cycling through the 8 types,
+which the branch predictor learns, so that the cost of the dispatch instructions themselves shows. */
+
+#include <random>           // For `std::mt19937_64`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../non_null_tagged_pointer.h"
+#include "bench.h"
+
+/* `Type<I>` is the `I`th of the types pointed to. */
+template <std::size_t I>
+struct Type {int value;};
+
+/* Returns a value computed differently for each type. It is never inlined, so that the arms of the
+dispatch cannot be merged into one. */
+template <std::size_t I>
+[[gnu::noinline]] int work(const Type<I> *p) {return p->value * static_cast<int>(2 * I + 3) + 1;}
+
+template <typename Pointer>
+void run(const char *name, const std::vector<Pointer> &ptrs) {
+    bench::report_time(name, bench::seconds_per_call([&] {
+        int sum = 0;
+        for (auto &ptr : ptrs) {sum += ptr.call([](auto p) {return work(p);});}
+        bench::do_not_optimize(sum);
+    }), static_cast<double>(ptrs.size()));
+}
+
+template <std::size_t... Is>
+void run_all(std::size_t n, std::index_sequence<Is...>) {
+    constexpr auto N = sizeof...(Is);
+    std::tuple<Type<Is>...> objects{Type<Is>{static_cast<int>(Is)}...};
+    TaggedPointer<Type<Is>...> choices[] = {&std::get<Is>(objects)...};
+    NonNullTaggedPointer<Type<Is>...> non_null_choices[] = {&std::get<Is>(objects)...};
+
+    for (bool random : {true, false}) {
+        std::vector<TaggedPointer<Type<Is>...>> ptrs;
+        std::vector<NonNullTaggedPointer<Type<Is>...>> non_null_ptrs;
+        ptrs.reserve(n);
+        non_null_ptrs.reserve(n);
+        std::mt19937_64 rng(42);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto choice = random ? rng() % N : i % N;
+            ptrs.push_back(choices[choice]);
+            non_null_ptrs.push_back(non_null_choices[choice]);
+        }
+
+        run(random ? "random: TaggedPointer::call" : "cycling: TaggedPointer::call", ptrs);
+        run(random ? "random: NonNullTaggedPointer::call" : "cycling: NonNullTaggedPointer::call",
+            non_null_ptrs);
+    }
+}
+
+int main(int argc, char **argv) {
+    run_all(bench::size_argument(argc, argv, std::size_t{1} << 20), std::make_index_sequence<8>{});
+}
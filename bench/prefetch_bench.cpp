@@ -0,0 +1,47 @@
+/* Measures the time per element of `prefetching_for_each` (see tagged_pointer_prefetch.h) for a
+range of prefetch distances, against a plain loop over `call`, on an array of `TaggedPointer`s to
+objects of a cache line each, visited in random order. By default there are 4M objects (256 MB,
+larger than the last-level cache of most CPUs); pass another number as the first argument. */
+
+#include <algorithm>        // For `std::shuffle`
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer_prefetch.h"
+#include "bench.h"
+
+struct alignas(64) A {long values[8];};
+struct alignas(64) B {long values[8];};
+using Pointer = TaggedPointer<A, B>;
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 22);
+
+    std::vector<A> as(n / 2);
+    std::vector<B> bs(n - n / 2);
+    for (std::size_t i = 0; i < as.size(); ++i) {as[i].values[0] = static_cast<long>(i);}
+    for (std::size_t i = 0; i < bs.size(); ++i) {bs[i].values[0] = static_cast<long>(i);}
+    std::vector<Pointer> ptrs;
+    ptrs.reserve(n);
+    for (auto &a : as) {ptrs.emplace_back(&a);}
+    for (auto &b : bs) {ptrs.emplace_back(&b);}
+    std::shuffle(ptrs.begin(), ptrs.end(), std::mt19937_64(42));
+    std::span<const Pointer> span(ptrs);
+    auto items = static_cast<double>(n);
+
+    bench::report_time("loop over call", bench::seconds_per_call([&] {
+        long sum = 0;
+        for (auto &ptr : ptrs) {sum += ptr.call([](auto p) {return p->values[0];});}
+        bench::do_not_optimize(sum);
+    }), items);
+    for (std::size_t distance : {1, 2, 4, 8, 16, 32, 64}) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "prefetching_for_each, distance %zu", distance);
+        bench::report_time(name, bench::seconds_per_call([&] {
+            long sum = 0;
+            prefetching_for_each<const Pointer>(span, [&](auto p) {sum += p->values[0];},
+                                                distance);
+            bench::do_not_optimize(sum);
+        }), items);
+    }
+}
@@ -0,0 +1,47 @@
+/* Measures the throughput of `tag_all` and `untag_all` (see tagged_pointer_bulk.h) with every
+kernel this CPU supports, against loops constructing each `TaggedPointer` and calling `ptr()` on
+each, on arrays of pointers (by default 16M elements, or the number given as the first argument).
+Throughput is in GB/s of pointers read. */
+
+#include <string>           // For `std::string`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer_bulk.h"
+#include "bench.h"
+
+struct A {int a;};
+struct B {int b;};
+using Pointer = TaggedPointer<A, B>;
+
+int main(int argc, char **argv) {
+    auto n = bench::size_argument(argc, argv, std::size_t{1} << 24);
+
+    std::vector<B> objects(n);
+    std::vector<B*> raw_ptrs(n);
+    for (std::size_t i = 0; i < n; ++i) {raw_ptrs[i] = &objects[i];}
+    std::vector<Pointer> ptrs(n);
+    std::vector<void*> untagged(n);
+    std::span<B* const> raw_span(raw_ptrs);
+    std::span<const Pointer> span(ptrs);
+    auto bytes = static_cast<double>(n * sizeof(Pointer));
+
+    bench::report_throughput("tag: loop over constructor", bench::seconds_per_call([&] {
+        for (std::size_t i = 0; i < n; ++i) {ptrs[i] = Pointer(raw_ptrs[i]);}
+        bench::do_not_optimize(ptrs.data());
+    }), bytes);
+    bench::report_throughput("untag: loop over ptr()", bench::seconds_per_call([&] {
+        for (std::size_t i = 0; i < n; ++i) {untagged[i] = ptrs[i].ptr();}
+        bench::do_not_optimize(untagged.data());
+    }), bytes);
+
+    for_each_bulk_isa([&](BulkIsa isa) {
+        std::string suffix = std::string(" (") + bulk_isa_name(isa) + ")";
+        bench::report_throughput("tag_all" + suffix, bench::seconds_per_call([&] {
+            tag_all(raw_span, ptrs.data());
+            bench::do_not_optimize(ptrs.data());
+        }), bytes);
+        bench::report_throughput("untag_all" + suffix, bench::seconds_per_call([&] {
+            untag_all(span, untagged.data());
+            bench::do_not_optimize(untagged.data());
+        }), bytes);
+    });
+}
@@ -0,0 +1,78 @@
+/* Measures the time per instruction of `run_threaded` (see threaded_interpreter.h) against a loop
+of `call`s, on a program of 8 opcodes which repeats the same random sequence of 64 instructions, so
+that the opcode following each instruction is predictable from its own opcode and history, but not
+from the previous opcode alone. By default the program has 1M instructions, or the number given as
+the first argument. `run_threaded` is measured with the accumulator captured by reference, and
+passed by value through the handlers. CMakeLists.txt builds this file twice: as `threaded_bench`,
+with the default computed `goto`s, and as `threaded_thunks_bench`, with
+`TAGGED_POINTER_NO_COMPUTED_GOTO`. */
+
+#include <cstdio>           // For `std::snprintf`
+#include <random>           // For `std::mt19937_64`
+#include <tuple>            // For `std::tuple`, `std::get`
+#include <utility>          // For `std::index_sequence`, `std::make_index_sequence`
+#include <vector>           // For `std::vector`
+#include "../threaded_interpreter.h"
+#include "bench.h"
+
+/* `Op<I>` is the `I`th opcode; each updates the accumulator in its own way. */
+template <std::size_t I>
+struct Op {long operand;};
+
+template <std::size_t I>
+long apply(const Op<I> *op, long acc) {
+    switch (I % 4) {
+        case 0: return acc + op->operand;
+        case 1: return acc ^ (op->operand << I);
+        case 2: return acc * 3 + op->operand;
+        default: return (acc >> 1) - op->operand;
+    }
+}
+
+template <std::size_t... Is>
+void run(std::size_t n, std::index_sequence<Is...>) {
+    using Instruction = TaggedPointer<Op<Is>...>;
+    constexpr auto N = sizeof...(Is);
+    constexpr std::size_t PERIOD = 64;
+
+    std::tuple<Op<Is>...> ops{Op<Is>{static_cast<long>(Is + 1)}...};
+    Instruction choices[] = {Instruction(&std::get<Is>(ops))...};
+    std::mt19937_64 rng(42);
+    std::vector<Instruction> sequence(PERIOD);
+    for (auto &instruction : sequence) {instruction = choices[rng() % N];}
+    std::vector<Instruction> program(n);
+    for (std::size_t i = 0; i < n; ++i) {program[i] = sequence[i % PERIOD];}
+    std::span<const Instruction> span(program);
+    auto items = static_cast<double>(n);
+
+    bench::report_time("loop over call", bench::seconds_per_call([&] {
+        long acc = 0;
+        for (auto &instruction : program) {
+            acc = instruction.call([&](auto op) {return apply(op, acc);});
+        }
+        bench::do_not_optimize(acc);
+    }), items);
+#ifdef TAGGED_POINTER_NO_COMPUTED_GOTO
+    const char *kind = "thunks";
+#else
+    const char *kind = "computed goto";
+#endif
+    char name[64];
+    std::snprintf(name, sizeof(name), "run_threaded (%s), captured state", kind);
+    bench::report_time(name, bench::seconds_per_call([&] {
+        long acc = 0;
+        run_threaded<const Instruction>(span, [&](auto op) {acc = apply(op, acc);});
+        bench::do_not_optimize(acc);
+    }), items);
+    std::snprintf(name, sizeof(name), "run_threaded (%s), state by value", kind);
+    bench::report_time(name, bench::seconds_per_call([&] {
+        long acc = run_threaded<const Instruction>(span, 0L, [](auto op, long &acc) {
+            acc = apply(op, acc);
+        });
+        bench::do_not_optimize(acc);
+    }), items);
+}
+
+int main(int argc, char **argv) {
+    run(bench::size_argument(argc, argv, std::size_t{1} << 20), std::make_index_sequence<8>{});
+}
@@ -0,0 +1,284 @@
+/* Implements `CommandBuffer<TP, Ops...>`, which defers operations on `TaggedPointer`s: instead of
+calling an operation right away, `record<Op>(tagged_ptr, args...)` appends a compact command (the
+pointer, the index of the operation, and its arguments, stored inline) to the buffer, and `flush`
+later executes all recorded commands, grouped by type and operation. When millions of operations
+on objects of mixed types are issued in arbitrary order, executing them immediately means one
+unpredictable dispatch per operation; after grouping, each group is executed by a tight loop
+specialized for its type and operation, so there is one dispatch per group instead, and the loop
+body can be inlined.
+
+Operations are declared as for `invoke` (see method_table.h): as stateless types with a static
+member function template `apply<T>(T *ptr, args...)`. For instance:
+
+    struct Translate {
+        template <typename T>
+        static void apply(T *shape, double dx, double dy) {shape->translate(dx, dy);}
+    };
+
+    CommandBuffer<Shape, Translate, Scale> commands;
+    commands.record<Translate>(my_shape, 1.0, 2.0);
+    ...
+    commands.flush();
+
+The commands are grouped by a counting sort on the key `tag * sizeof...(Ops) + op`: as there are
+few keys, `record` keeps the number of commands with each key up to date, and `flush` moves each
+command once, straight to its place in a scratch buffer, from which the groups are replayed. The
+sort is stable, so the commands of a group run in the order in which they were recorded. Commands
+of different groups, however, run in a different order than they were recorded in, and this
+includes different operations on the same object: recording `Mul(10)` then `Inc(1)` on the same
+object may run `Inc(1)` first. So `flush` only suits operations that commute with each other, on
+the same object as well as across objects.
+
+When operations on the same object must run in order, use `flush_in_order` instead, which sorts on
+the tag alone: all commands on objects of the same type then run in the order in which they were
+recorded, and only commands on objects of different types are reordered. Each maximal run of
+consecutive commands with the same operation is still replayed by a single loop, so this groups
+as well as `flush` when the operations on each type come in runs, and degrades to one dispatch per
+command when they alternate.
+
+Grouping only pays off when the immediate dispatch is costly: when the types are many, come in
+an unpredictable order, and have operations that compile to different code. When every type's
+operation compiles to the same code, the compiler merges the arms of the dispatch, and calling
+immediately is several times faster than recording and flushing (see
+bench/command_buffer_bench.cpp).
+
+A `CommandBuffer` is not thread-safe. Each thread should record into its own buffer (for instance,
+a `thread_local` one), which makes recording lock-free, and flush it itself. */
+
+#pragma once
+
+#include <algorithm>        // For `std::max`
+#include <array>            // For `std::array`
+#include <cassert>          // For `assert`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`, `uint32_t`
+#include <cstring>          // For `std::memcpy`
+#include <memory>           // For `std::unique_ptr`, `std::make_unique_for_overwrite`
+#include <tuple>            // For `std::tuple`, `std::tuple_element_t`
+#include <type_traits>      // For `std::decay_t`, `std::is_trivially_copyable_v`
+#include <utility>          // For `std::index_sequence`
+#include <vector>           // For `std::vector`
+#include "method_table.h"
+#include "tagged_pointer.h"
+
+namespace detail {
+
+/* `Command<ArgSize>` is a recorded command: the `tagged_address` of the pointer, the sort key of
+its group, and the arguments of the operation, packed into `args`. */
+template <std::size_t ArgSize>
+struct Command {
+    uintptr_t bits;
+    uint32_t key;
+    unsigned char args[ArgSize];
+};
+
+/* `CommandArgs<R (*)(T*, Args...)>` describes how the arguments of an operation whose `apply<T>`
+has the given signature are packed into a `Command`: each argument is stored by value (as a
+`std::decay_t<Arg>`), right after the previous one, starting at `offsets[i]`. */
+template <typename ApplyPtr>
+struct CommandArgs;
+
+template <typename R, typename T, typename... Args>
+struct CommandArgs<R (*)(T*, Args...)> {
+    static_assert(((std::is_trivially_copyable_v<std::decay_t<Args>>
+                    && std::is_default_constructible_v<std::decay_t<Args>>) && ...),
+                  "The arguments of a recorded operation must be trivially copyable and "
+                  "default-constructible");
+
+    using VoidPtr = typename ErasedMethod<R (*)(T*, Args...)>::VoidPtr;
+
+    constexpr static std::array<std::size_t, sizeof...(Args) + 1> offsets = [] {
+        std::array<std::size_t, sizeof...(Args) + 1> result{};
+        std::size_t sizes[] = {sizeof(std::decay_t<Args>)..., 0};
+        for (std::size_t i = 0; i < sizeof...(Args); ++i) {result[i + 1] = result[i] + sizes[i];}
+        return result;
+    }();
+    constexpr static std::size_t size = offsets[sizeof...(Args)];
+
+    /* Copies `args...` into `out`. */
+    static void store(unsigned char *out, const std::decay_t<Args> &...args) {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (std::memcpy(out + offsets[I], &args, sizeof(args)), ...);
+        }(std::index_sequence_for<Args...>{});
+    }
+
+    /* Returns the argument of type `A` stored at `in`. */
+    template <typename A>
+    static A load(const unsigned char *in) {
+        A value;
+        std::memcpy(&value, in, sizeof(A));
+        return value;
+    }
+
+    /* Calls `Op::apply<U>` for each of the commands `commands[0, n)`, which all point to a `U`. */
+    template <typename Op, typename U, typename Cmd>
+    static void replay(const Cmd *commands, std::size_t n, uintptr_t ptr_mask) {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            for (std::size_t i = 0; i < n; ++i) {
+                auto ptr = reinterpret_cast<VoidPtr>(commands[i].bits & ptr_mask);
+                Op::template apply<U>(static_cast<CopyConst_t<VoidPtr, U>*>(ptr),
+                                      load<std::decay_t<Args>>(commands[i].args + offsets[I])...);
+            }
+        }(std::index_sequence_for<Args...>{});
+    }
+};
+
+/* `CommandArgsOf<Op, TaggedPointer<T0, Ts...>>` is the `CommandArgs` of `Op`, as given by the
+signature of `Op::apply<T0>` (which, by `Implements`, is the same for all types). */
+template <typename Op, typename TP>
+struct CommandArgsOfImpl;
+
+template <typename Op, typename T0, typename... Ts>
+struct CommandArgsOfImpl<Op, TaggedPointer<T0, Ts...>> {
+    using type = CommandArgs<decltype(&Op::template apply<T0>)>;
+};
+
+template <typename Op, typename TP>
+using CommandArgsOf = typename CommandArgsOfImpl<Op, TP>::type;
+
+/* `ReplayTable<Cmd, TaggedPointer<Ts...>, Ops...>::table[key]` points to the function replaying
+a group of commands with key `key`, that is, with tag `key / sizeof...(Ops)` and operation
+`key % sizeof...(Ops)`. The entries for the null tag are null. */
+template <typename Cmd, typename TP, typename... Ops>
+struct ReplayTable;
+
+template <typename Cmd, typename... Ts, typename... Ops>
+struct ReplayTable<Cmd, TaggedPointer<Ts...>, Ops...> {
+    using Replay = void (*)(const Cmd*, std::size_t, uintptr_t);
+    constexpr static std::size_t num_ops = sizeof...(Ops);
+
+    template <std::size_t K>
+    constexpr static Replay entry() {
+        if constexpr (K < num_ops) {
+            return nullptr;
+        } else {
+            using Op = std::tuple_element_t<K % num_ops, std::tuple<Ops...>>;
+            using U = std::tuple_element_t<K / num_ops - 1, std::tuple<Ts...>>;
+            using Args = CommandArgsOf<Op, TaggedPointer<Ts...>>;
+            return &Args::template replay<Op, U, Cmd>;
+        }
+    }
+
+    constexpr static auto table = []<std::size_t... K>(std::index_sequence<K...>) {
+        return std::array<Replay, sizeof...(K)>{entry<K>()...};
+    }(std::make_index_sequence<(sizeof...(Ts) + 1) * num_ops>{});
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `CommandBuffer<TP, Ops...>` records the operations `Ops...` on `TP`s, where `TP` is a
+`TaggedPointer` (or a type that inherits from one) that implements all of them, and executes them
+on `flush`, grouped by type and operation; see the top of this file. */
+template <typename TP, typename... Ops>
+requires (sizeof...(Ops) > 0) && Implements<TP, Interface<Ops...>>
+class CommandBuffer {
+    using Base = detail::TaggedPointerBase_t<TP>;
+
+    /* `ARG_SIZE` is the number of bytes needed by the arguments of the operation taking the most
+    (and at least 1). */
+    constexpr static std::size_t ARG_SIZE = std::max({std::size_t{1},
+                                                      detail::CommandArgsOf<Ops, Base>::size...});
+
+    using Cmd = detail::Command<ARG_SIZE>;
+    using Table = detail::ReplayTable<Cmd, Base, Ops...>;
+
+    /* `NUM_KEYS` is the number of keys, including those of the null tag, which are never used. */
+    constexpr static std::size_t NUM_KEYS = (Base::num_types() + 1) * sizeof...(Ops);
+
+    /* `commands` holds the recorded commands, in the order in which they were recorded, and
+    `key_counts[key]` the number of them with key `key`. `scratch` holds room for
+    `scratch_capacity` commands, which are sorted into it on `flush`; as it is overwritten
+    entirely, it is grown without being initialized. */
+    std::vector<Cmd> commands;
+    std::array<std::size_t, NUM_KEYS> key_counts{};
+    std::unique_ptr<Cmd[]> scratch;
+    std::size_t scratch_capacity = 0;
+
+public:
+
+    /* Records `Op::apply<T>(typed_ptr, args...)`, to be executed on the next `flush`, where
+    `typed_ptr` is the pointer stored in `tagged_ptr`, casted to its type `T`. `tagged_ptr` must
+    not be null (this is checked with `assert`), and if `Op::apply<T>` takes a pointer to
+    non-const, it must not be const either. The arguments are copied into the buffer. */
+    template <typename Op, typename Ptr, typename... Args>
+    requires detail::ContainsType<Op, Ops...> && std::is_same_v<std::remove_cvref_t<Ptr>, TP>
+          && (!std::is_const_v<std::remove_reference_t<Ptr>>
+              || std::is_const_v<std::remove_pointer_t<
+                     typename detail::CommandArgsOf<Op, Base>::VoidPtr>>)
+    void record(Ptr &&tagged_ptr, Args &&...args) {
+        assert(tagged_ptr.tag() != 0 && "Cannot `record` an operation on a tagged null pointer");
+        auto key = tagged_ptr.tag() * sizeof...(Ops) + detail::IndexOfType_v<Op, Ops...>;
+        Cmd command;
+        command.bits = detail::TaggedPointerAccess::bits(tagged_ptr);
+        command.key = static_cast<uint32_t>(key);
+        detail::CommandArgsOf<Op, Base>::store(command.args, std::forward<Args>(args)...);
+        commands.push_back(command);
+        ++key_counts[key];
+    }
+
+    /* Executes all recorded commands, grouped by type and operation (within a group, in the
+    order in which they were recorded), and clears this buffer. The operations must not record
+    into this buffer. */
+    void flush() {sort_and_replay<1>();}
+
+    /* Executes all recorded commands on objects of each type in the order in which they were
+    recorded, type by type, and clears this buffer; see the top of this file. The operations must
+    not record into this buffer. */
+    void flush_in_order() {sort_and_replay<sizeof...(Ops)>();}
+
+    /* Discards all recorded commands without executing them. */
+    void clear() {
+        commands.clear();
+        key_counts.fill(0);
+    }
+
+    /* Returns the number of recorded commands. */
+    std::size_t size() const {return commands.size();}
+
+    /* Returns whether no commands are recorded. */
+    bool empty() const {return commands.empty();}
+
+private:
+
+    /* Stably sorts the recorded commands into `scratch` by `key / KeysPerBucket`, replays each
+    maximal run of consecutive commands with the same type and operation with a single loop, and
+    clears this buffer (even if an operation throws, in which case the commands not yet replayed
+    are discarded). */
+    template <std::size_t KeysPerBucket>
+    void sort_and_replay() {
+        auto n = commands.size();
+        if (scratch_capacity < n) {
+            scratch_capacity = std::max(n, 2 * scratch_capacity);
+            scratch = std::make_unique_for_overwrite<Cmd[]>(scratch_capacity);
+        }
+
+        std::array<std::size_t, NUM_KEYS / KeysPerBucket> offsets;
+        std::size_t offset = 0;
+        for (std::size_t bucket = 0; bucket < offsets.size(); ++bucket) {
+            offsets[bucket] = offset;
+            for (std::size_t key = bucket * KeysPerBucket; key < (bucket + 1) * KeysPerBucket;
+                 ++key) {
+                offset += key_counts[key];
+            }
+        }
+        for (const auto &command : commands) {
+            scratch[offsets[command.key / KeysPerBucket]++] = command;
+        }
+
+        constexpr auto ptr_mask = detail::TaggedPointerAccess::ptr_mask<Base>();
+        const Cmd *sorted = scratch.get();
+        try {
+            for (std::size_t begin = 0; begin < n; ) {
+                auto key = sorted[begin].key;
+                auto end = begin + 1;
+                while (end < n && sorted[end].key == key) {++end;}
+                Table::table[key](sorted + begin, end - begin, ptr_mask);
+                begin = end;
+            }
+        } catch (...) {
+            clear();
+            throw;
+        }
+        clear();
+    }
+};
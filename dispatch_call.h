@@ -7,13 +7,13 @@ namespace detail {
 
 /* Handle parameter packs with exactly 1 type (nonconst version) */
 template <typename Func, typename T>
-auto dispatch_call(Func &&func, void *ptr, unsigned type_index) {
+auto dispatch_call(Func &&func, void *ptr, [[maybe_unused]] unsigned type_index) {
     return func(static_cast<T*>(ptr));
 }
 
 /* Handle parameter packs with exactly 1 type (const version) */
 template <typename Func, typename T>
-auto dispatch_call(Func &&func, const void *ptr, unsigned type_index) {
+auto dispatch_call(Func &&func, const void *ptr, [[maybe_unused]] unsigned type_index) {
     return func(static_cast<const T*>(ptr));
 }
 
@@ -192,9 +192,12 @@ auto dispatch_call(Func &&func, const void *ptr, unsigned type_index) {
     }
 }
 
-/* Handle parameter packs with more than 8 types (non-const version) */
+/* Handle parameter packs with more than 8 types (non-const version). The `requires` clause keeps
+this overload from also matching exactly 8 types (with an empty `Ts...`), which would make calls
+with 8 or 16 types ambiguous. */
 template <typename Func, typename T0, typename T1, typename T2, typename T3,
         typename T4, typename T5, typename T6, typename T7, typename... Ts>
+requires (sizeof...(Ts) > 0)
 auto dispatch_call(Func &&func, void *ptr, unsigned type_index) {
     /* Check if `type_index` corresponds to any of the first 8 types. If it does, then
     we are done. Otherwise, if `type_index` does not correspond to any of the first 8
@@ -219,6 +222,7 @@ auto dispatch_call(Func &&func, void *ptr, unsigned type_index) {
 /* Handle parameter packs with more than 8 types (const version) */
 template <typename Func, typename T0, typename T1, typename T2, typename T3,
         typename T4, typename T5, typename T6, typename T7, typename... Ts>
+requires (sizeof...(Ts) > 0)
 auto dispatch_call(Func &&func, const void *ptr, unsigned type_index) {
     /* Check if `type_index` corresponds to any of the first 8 types. If it does, then
     we are done. Otherwise, if `type_index` does not correspond to any of the first 8
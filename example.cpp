@@ -109,6 +109,13 @@ int main()
     my_shape.print_info();
     std::cout << "my_shape.get_area() returned " << my_shape.get_area() << std::endl;
 
+    /* Example: `call_all` runs several operations on the typed pointer after a single dispatch,
+    returning their results in a `std::tuple` (with `std::monostate` in place of `void`). */
+    std::cout << "Again, through one dispatch: ";
+    [[maybe_unused]] auto [info, area] = my_shape.call_all([](auto ptr){return ptr->print_info();},
+                                                           [](auto ptr){return ptr->get_area();});
+    assert(area == my_shape.get_area());
+
     /* Example: == and != operators for `TaggedPointer` */
     auto my_shape2 = my_shape;
     assert(my_shape == my_shape2);
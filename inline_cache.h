@@ -0,0 +1,231 @@
+/* Implements `InlineCache<TP>`, an opt-in, self-tuning polymorphic inline cache for a single
+`call` site. Many call sites only ever see one or two types in a given deployment, but which ones
+is not known at compile-time (otherwise, `hot` could be used instead). An `InlineCache` finds out
+at runtime:
+- It first profiles the tags of a window of calls, dispatching them normally.
+- If one tag accounts for nearly all of them, the site is monomorphic, and later calls compare the
+  tag against that tag, and on a match, branch to the arm for that type without any indirect jump.
+  If two tags do, the site is bimorphic, and both are compared. Otherwise, the site is
+  megamorphic, and calls are simply dispatched normally.
+- Whenever the misses since the last check exceed a share of the calls, the site is profiled
+  again, so the cache follows shifts in the type distribution. A megamorphic site is profiled
+  again after a number of calls that doubles every time it is found megamorphic again, so that a
+  site that stays megamorphic is seldom profiled.
+
+An `InlineCache` is not thread-safe; it is meant to be declared `thread_local` (or `static`, in
+single-threaded code) at the call site it serves:
+
+    double Shape::get_area() const {
+        thread_local InlineCache<Shape> cache;
+        return cache.call(*this, [](auto ptr) {return ptr->get_area();});
+    }
+*/
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cstdint>          // For `uint32_t`, `uint64_t`
+#include <tuple>            // For `std::tuple`, `std::tuple_element_t`
+#include <type_traits>      // For `std::remove_cvref_t`, `std::remove_reference_t`
+#include "tagged_pointer.h"
+
+namespace detail {
+
+/* `CachedDispatch<Func, VoidPtr, TaggedPointer<Ts...>>::call(func, ptr, tag)` calls `func`, passing
+to it `ptr` casted to the type with tag `tag` (which must not be the null tag) in
+`TaggedPointer<Ts...>`. The type is found by comparing `tag` with each tag in turn, rather than
+with the jump table of `call`: as an `InlineCache` hit has the same tag on nearly every call, every
+comparison is predicted correctly, and no indirect branch is taken. */
+template <typename Func, typename VoidPtr, typename TP>
+struct CachedDispatch;
+
+template <typename Func, typename VoidPtr, typename... Ts>
+struct CachedDispatch<Func, VoidPtr, TaggedPointer<Ts...>> {
+    using Result = UnifiedReturn_t<Func, VoidPtr, Ts...>;
+
+    template <typename T>
+    static Result arm(Func &func, VoidPtr ptr) {
+#ifdef TAGGED_POINTER_INSTRUMENT
+        /* Cache hits are counted here, at the same site as the misses, which go through `call`. */
+        DispatchProbe probe(dispatch_site<std::remove_cvref_t<Func>, Ts...>(),
+                            IndexOfType_v<T, Ts...>);
+#endif
+        return call_unified_arm<VoidPtr, Ts...>(func, static_cast<CopyConst_t<VoidPtr, T>*>(ptr));
+    }
+
+    template <unsigned Tag = 1>
+    static Result call(Func &func, VoidPtr ptr, unsigned tag) {
+        using T = std::tuple_element_t<Tag - 1, std::tuple<Ts...>>;
+        if constexpr (Tag == sizeof...(Ts)) {
+            return arm<T>(func, ptr);
+        } else {
+            if (tag == Tag) {return arm<T>(func, ptr);}
+            return call<Tag + 1>(func, ptr, tag);
+        }
+    }
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `InlineCacheState` is the state of an `InlineCache`; see the top of this file. */
+enum class InlineCacheState {Profiling, Monomorphic, Bimorphic, Megamorphic};
+
+/* `InlineCacheStats` holds the counters of an `InlineCache`: the number of calls that were
+profiled, that hit the cache, and that missed it (including all calls made while megamorphic). */
+struct InlineCacheStats {
+    InlineCacheState state;
+    uint64_t profiled;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/* `InlineCache<TP>` is an inline cache for a `call` site on `TP`s, where `TP` is a `TaggedPointer`
+(or a type that inherits from one). */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+class InlineCache {
+    /* `NO_TAG` marks an unused entry of `cached_tags`; it never equals a real tag. */
+    constexpr static unsigned NO_TAG = ~0u;
+
+    /* `PROFILE_WINDOW` is the number of calls profiled before choosing a state. Whenever a
+    monomorphic or bimorphic site has missed more than `MAX_EPOCH_MISSES` times since the last
+    check, it is profiled again if that took at most `EPOCH_LENGTH` calls. Only misses are
+    checked, so that hits need not count down to the end of an epoch. */
+    constexpr static unsigned PROFILE_WINDOW = 256;
+    constexpr static unsigned EPOCH_LENGTH = 4096;
+    constexpr static unsigned MAX_EPOCH_MISSES = EPOCH_LENGTH / 16;
+
+    /* A megamorphic site is profiled again after `megamorphic_calls` calls, which starts at
+    `EPOCH_LENGTH` and doubles, up to `MAX_MEGAMORPHIC_CALLS`, every time the site is found
+    megamorphic again. */
+    constexpr static uint64_t MAX_MEGAMORPHIC_CALLS = uint64_t{EPOCH_LENGTH} << 6;
+
+    /* A site is monomorphic (or bimorphic) if its most frequent tag (or two most frequent tags)
+    accounted for at least `HIT_NUMERATOR / HIT_DENOMINATOR` of the profiled calls. */
+    constexpr static unsigned HIT_NUMERATOR = 15;
+    constexpr static unsigned HIT_DENOMINATOR = 16;
+
+    /* `cached_tags` holds the tags that hit the cache; it is `{NO_TAG, NO_TAG}` when profiling or
+    megamorphic, and `{tag, NO_TAG}` when monomorphic. */
+    unsigned cached_tags[2] = {NO_TAG, NO_TAG};
+    InlineCacheState current_state = InlineCacheState::Profiling;
+
+    /* `calls_left` is the number of calls left until the end of the profiling window, or until a
+    megamorphic site is profiled again. `epoch_misses` is the number of misses since the last
+    check, and `epoch_start` the number of hits and misses in `counters` at that check.
+    `tag_counts[tag]` is the number of profiled calls with tag `tag`. */
+    uint64_t calls_left = PROFILE_WINDOW;
+    uint64_t megamorphic_calls = EPOCH_LENGTH;
+    unsigned epoch_misses = 0;
+    uint64_t epoch_start = 0;
+    std::array<uint32_t, TP::num_types() + 1> tag_counts{};
+
+    InlineCacheStats counters{InlineCacheState::Profiling, 0, 0, 0};
+
+    /* Chooses the state of this cache from `tag_counts`, and starts a new epoch. The null tag is
+    never cached, as `call` must not be used on tagged null pointers anyway. */
+    void finish_profiling() {
+        unsigned first = 0, second = 0;
+        uint32_t first_count = 0, second_count = 0;
+        for (unsigned tag = 1; tag < tag_counts.size(); ++tag) {
+            if (tag_counts[tag] > first_count) {
+                second = first;
+                second_count = first_count;
+                first = tag;
+                first_count = tag_counts[tag];
+            } else if (tag_counts[tag] > second_count) {
+                second = tag;
+                second_count = tag_counts[tag];
+            }
+        }
+        auto is_enough = [](uint32_t count) {
+            return count * HIT_DENOMINATOR >= PROFILE_WINDOW * HIT_NUMERATOR;
+        };
+        if (first != 0 && is_enough(first_count)) {
+            current_state = InlineCacheState::Monomorphic;
+            cached_tags[0] = first;
+        } else if (second != 0 && is_enough(first_count + second_count)) {
+            current_state = InlineCacheState::Bimorphic;
+            cached_tags[0] = first;
+            cached_tags[1] = second;
+        } else {
+            current_state = InlineCacheState::Megamorphic;
+        }
+        tag_counts.fill(0);
+        if (current_state == InlineCacheState::Megamorphic) {
+            calls_left = megamorphic_calls;
+            if (megamorphic_calls < MAX_MEGAMORPHIC_CALLS) {megamorphic_calls *= 2;}
+        } else {
+            megamorphic_calls = EPOCH_LENGTH;
+        }
+        start_epoch();
+    }
+
+    /* Starts counting the misses anew. */
+    void start_epoch() {
+        epoch_misses = 0;
+        epoch_start = counters.hits + counters.misses;
+    }
+
+    /* Starts profiling the call site again. */
+    void start_profiling() {
+        current_state = InlineCacheState::Profiling;
+        cached_tags[0] = cached_tags[1] = NO_TAG;
+        calls_left = PROFILE_WINDOW;
+    }
+
+    /* Records a call with tag `tag` that did not hit the cache. */
+    void record_miss(unsigned tag) {
+        if (current_state == InlineCacheState::Profiling) {
+            ++tag_counts[tag];
+            ++counters.profiled;
+            if (--calls_left == 0) {finish_profiling();}
+        } else if (current_state == InlineCacheState::Megamorphic) {
+            ++counters.misses;
+            if (--calls_left == 0) {start_profiling();}
+        } else {
+            ++counters.misses;
+            if (++epoch_misses <= MAX_EPOCH_MISSES) {return;}
+            if (counters.hits + counters.misses - epoch_start <= EPOCH_LENGTH) {
+                start_profiling();
+            } else {
+                start_epoch();
+            }
+        }
+    }
+
+public:
+
+    /* Calls `func` exactly as `tagged_ptr.call(func)` does, where `tagged_ptr` is a (possibly
+    const) `TP`. If the tag of `tagged_ptr` is cached, it is found with one or two comparisons,
+    and the type with a chain of comparisons that are all predicted correctly (see
+    `detail::CachedDispatch`), so that, unlike `call`, a hit takes no indirect branch. */
+    template <typename Ptr, typename Func>
+    requires std::is_same_v<std::remove_cvref_t<Ptr>, TP>
+    auto call(Ptr &&tagged_ptr, Func &&func) {
+        auto ptr = tagged_ptr.ptr();
+        using Dispatch = detail::CachedDispatch<std::remove_reference_t<Func>, decltype(ptr),
+                                                detail::TaggedPointerBase_t<TP>>;
+
+        auto tag = tagged_ptr.tag();
+        if (tag == cached_tags[0] || tag == cached_tags[1]) [[likely]] {
+            ++counters.hits;
+            return Dispatch::call(func, ptr, tag);
+        }
+        record_miss(tag);
+        return static_cast<typename Dispatch::Result>(tagged_ptr.call(func));
+    }
+
+    /* Returns the current state and counters of this cache. */
+    InlineCacheStats stats() const {
+        auto result = counters;
+        result.state = current_state;
+        return result;
+    }
+
+    /* Resets the counters of this cache, but not its state. */
+    void reset_stats() {
+        counters = {current_state, 0, 0, 0};
+        start_epoch();
+    }
+};
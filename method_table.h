@@ -0,0 +1,120 @@
+/* Implements static method tables for `TaggedPointer`s. `call` instantiates `dispatch_call` with
+its lambda at every call site, which, in a large program with many call sites, costs code size and
+compile time. Instead, an operation can be declared once, as a stateless type with a static member
+function template `apply`:
+
+    struct GetArea {
+        template <typename T>
+        static double apply(const T *shape) {return shape->get_area();}
+    };
+
+For each operation and `TaggedPointer<Ts...>`, a table of function pointers indexed by `tag()` is
+generated at compile-time (with one entry per type, calling `apply<T>`), and `invoke<GetArea>(tp)`
+then compiles down to a load from the table and an indirect call, at every call site:
+
+    struct Shape : public TaggedPointer<Circle, RightTriangle, Rectangle> {
+        using TaggedPointer::TaggedPointer;
+        double get_area() const {return invoke<GetArea>(*this);}
+    };
+
+The tables are `constexpr static` data members, so every translation unit shares the same table,
+and each `apply<T>` is compiled once per program. The pointer itself stays 8 bytes, and the objects
+still carry no virtual table pointer. An `Interface<Ops...>` groups operations, so that
+`Implements<TP, Interface<Ops...>>` can check in one place that every type supports every one. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cassert>          // For `assert`
+#include <type_traits>      // For `std::remove_cvref_t`, `std::is_const_v`
+#include <utility>          // For `std::forward`
+#include "tagged_pointer.h"
+
+/* `Interface<Ops...>` names the set of operations `Ops...`. */
+template <typename... Ops>
+struct Interface {};
+
+namespace detail {
+
+/* `ErasedMethod<R (*)(T*, Args...)>` describes the type-erased version of a pointer to
+`Op::apply<T>`, whose first parameter is a `void*` (or `const void*`, if `T` is const). */
+template <typename ApplyPtr>
+struct ErasedMethod;
+
+template <typename R, typename T, typename... Args>
+struct ErasedMethod<R (*)(T*, Args...)> {
+    using VoidPtr = std::conditional_t<std::is_const_v<T>, const void*, void*>;
+    using Pointer = R (*)(VoidPtr, Args...);
+
+    /* Calls `Op::apply<U>`, casting `ptr` back to a `U*`. */
+    template <typename Op, typename U>
+    static R thunk(VoidPtr ptr, Args... args) {
+        return Op::template apply<U>(static_cast<CopyConst_t<VoidPtr, U>*>(ptr),
+                                     std::forward<Args>(args)...);
+    }
+};
+
+/* `MethodOf<Op, T>` is the `ErasedMethod` of `Op`, as given by the signature of `Op::apply<T>`;
+`Op::apply` must not be overloaded. */
+template <typename Op, typename T>
+using MethodOf = ErasedMethod<decltype(&Op::template apply<T>)>;
+
+/* `HasMethods<Op, T0, Ts...>` is satisfied iff `Op::apply<T>` exists for every type `T` in
+`T0, Ts...`, always with the same type-erased signature. */
+template <typename Op, typename T, typename Pointer>
+concept HasMethodWith = requires {typename MethodOf<Op, T>::Pointer;}
+                     && std::is_same_v<typename MethodOf<Op, T>::Pointer, Pointer>;
+
+template <typename Op, typename T0, typename... Ts>
+concept HasMethods = requires {typename MethodOf<Op, T0>::Pointer;}
+                  && (HasMethodWith<Op, Ts, typename MethodOf<Op, T0>::Pointer> && ...);
+
+/* `MethodTable<Op, TaggedPointer<Ts...>>::table[tag]` points to the thunk calling
+`Op::apply<T>`, where `T` is the type with tag `tag`. The entry for the null tag is null. Being a
+`constexpr static` data member, the table is implicitly `inline`, and so shared by all translation
+units. */
+template <typename Op, typename TP>
+struct MethodTable;
+
+template <typename Op, typename T0, typename... Ts>
+struct MethodTable<Op, TaggedPointer<T0, Ts...>> {
+    constexpr static bool is_implemented = HasMethods<Op, T0, Ts...>;
+
+    using Method = MethodOf<Op, T0>;
+    constexpr static std::array<typename Method::Pointer, sizeof...(Ts) + 2> table = {
+        nullptr, &Method::template thunk<Op, T0>, &Method::template thunk<Op, Ts>...
+    };
+
+#ifdef TAGGED_POINTER_INSTRUMENT
+    /* Returns the counters of `invoke<Op>` on this `TaggedPointer`, a site named after `Op`. */
+    static DispatchSiteCounters &site() {return dispatch_site<Op, T0, Ts...>();}
+#endif
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `Implements<TP, Interface<Ops...>>` is satisfied iff `TP` is a `TaggedPointer` (or a type
+inheriting from one), and, for every operation `Op` in `Ops...`, `Op::apply<T>` exists for every
+type `T` `TP` can point to, always with the same type-erased signature. Only the declarations of
+`Op::apply<T>` are checked, so `apply` should be constrained on what it requires of `T`. */
+template <typename TP, typename Iface>
+concept Implements = detail::TaggedPointerLike<TP> && []<typename... Ops>(Interface<Ops...>*) {
+    return (detail::MethodTable<Ops, detail::TaggedPointerBase_t<TP>>::is_implemented && ...);
+}(static_cast<Iface*>(nullptr));
+
+/* Calls `Op::apply<T>(typed_ptr, args...)`, where `typed_ptr` is the pointer stored in
+`tagged_ptr`, casted to its type `T`, through the method table of `Op`, and returns the result.
+`tagged_ptr` is a `TaggedPointer` (or a type inheriting from one), and must not be null (this is
+checked with `assert`). If `Op::apply<T>` takes a pointer to non-const, `tagged_ptr` must not be
+const either. */
+template <typename Op, typename TP, typename... Args>
+requires detail::TaggedPointerLike<std::remove_cvref_t<TP>>
+decltype(auto) invoke(TP &&tagged_ptr, Args &&...args) {
+    using Base = detail::TaggedPointerBase_t<std::remove_cvref_t<TP>>;
+    assert(tagged_ptr.tag() != 0 && "Cannot `invoke` an operation on a tagged null pointer");
+#ifdef TAGGED_POINTER_INSTRUMENT
+    detail::DispatchProbe probe(detail::MethodTable<Op, Base>::site(), tagged_ptr.tag() - 1);
+#endif
+    return detail::MethodTable<Op, Base>::table[tagged_ptr.tag()](tagged_ptr.ptr(),
+                                                                    std::forward<Args>(args)...);
+}
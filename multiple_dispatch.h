@@ -0,0 +1,176 @@
+/* Implements multiple dispatch over several `TaggedPointer`s at once: `dispatch(func, a, b)` calls
+`func(typed_a, typed_b)`, where `typed_a` and `typed_b` are the pointers stored in `a` and `b`,
+casted to their correct types. Nesting one `call` inside another does the same with two dependent
+`switch`es; `dispatch` instead combines the tags into a single index into a table of function
+pointers, with one entry per combination of types, generated at compile-time. For instance, for
+collision detection between `Shape`s (see example.cpp):
+
+    bool collide(const Circle*, const Circle*);
+    bool collide(const Circle*, const Rectangle*);
+    ...
+    bool hit = dispatch([](auto *a, auto *b) {return collide(a, b);}, shape_a, shape_b);
+
+When the operation is symmetric, `dispatch_symmetric(func, a, b)` only requires `func` for the
+pairs of types `(T_i, T_j)` with `i <= j`, and calls `func(typed_b, typed_a)` for the other
+pairs, which halves the number of overloads to write and of instantiations to compile. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cassert>          // For `assert`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`
+#include <tuple>            // For `std::tuple`, `std::tuple_element_t`
+#include <type_traits>      // For `std::remove_cvref_t`, `std::conditional_t`
+#include <utility>          // For `std::index_sequence`
+#include "tagged_pointer.h"
+
+namespace detail {
+
+/* `DispatchArg<TP, IsConst>` describes an argument of `dispatch` whose type, after removing
+references and cv-qualifiers, is the `TaggedPointer` (or type inheriting from one) `TP`.
+`Pointer<i>` is the type of the pointer `func` receives when the argument points to the `i`th type
+(zero-indexed) of its type pack; it points to const iff `IsConst` is `true`. */
+template <typename TP, bool IsConst, typename Base = TaggedPointerBase_t<TP>>
+struct DispatchArg;
+
+template <typename TP, bool IsConst, typename... Ts>
+struct DispatchArg<TP, IsConst, TaggedPointer<Ts...>> {
+    constexpr static std::size_t num_types = sizeof...(Ts);
+
+    template <std::size_t I>
+    using Pointer = std::conditional_t<IsConst, const std::tuple_element_t<I, std::tuple<Ts...>>*,
+                                       std::tuple_element_t<I, std::tuple<Ts...>>*>;
+};
+
+/* `DispatchArgOf<TPRef>` is the `DispatchArg` for an argument of `dispatch` of (forwarding
+reference) type `TPRef`. */
+template <typename TPRef>
+using DispatchArgOf = DispatchArg<std::remove_cvref_t<TPRef>,
+                                  std::is_const_v<std::remove_reference_t<TPRef>>>;
+
+/* Returns the zero-indexed position, within the type pack of the `K`th argument in `Args...`, of
+the type that argument has in the combination with index `C`. Combinations are numbered in
+row-major order: the last argument's type varies fastest. */
+template <std::size_t C, std::size_t K, typename... Args>
+constexpr std::size_t combination_type_index() {
+    constexpr std::array<std::size_t, sizeof...(Args)> num_types = {Args::num_types...};
+    std::size_t stride = 1;
+    for (std::size_t k = K + 1; k < sizeof...(Args); ++k) {stride *= num_types[k];}
+    return (C / stride) % num_types[K];
+}
+
+/* Calls `func` with `ptrs[k]`, casted to the type the `k`th argument has in the combination with
+index `C`, for every `k`. */
+template <std::size_t C, typename Func, typename... Args, std::size_t... K>
+decltype(auto) call_combination(Func &func, void *const *ptrs, std::index_sequence<K...>) {
+    return func(static_cast<typename Args::template Pointer<
+        combination_type_index<C, K, Args...>()>>(ptrs[K])...);
+}
+
+/* `DispatchResult<Func, Args...>` is the type returned by `func` for the first combination of
+types; `func` must return this same type for every other combination. */
+template <typename Func, typename... Args>
+using DispatchResult = decltype(call_combination<0, Func, Args...>(
+    std::declval<Func&>(), nullptr, std::index_sequence_for<Args...>{}));
+
+/* The entry of the dispatch table for the combination with index `C`. */
+template <std::size_t C, typename Func, typename... Args>
+DispatchResult<Func, Args...> dispatch_thunk(Func &func, void *const *ptrs) {
+    using Result = decltype(call_combination<C, Func, Args...>(func, ptrs,
+                                                               std::index_sequence_for<Args...>{}));
+    static_assert(std::is_same_v<Result, DispatchResult<Func, Args...>>,
+                  "`func` must return the same type for every combination of types");
+    return call_combination<C, Func, Args...>(func, ptrs, std::index_sequence_for<Args...>{});
+}
+
+/* The entry of the symmetric dispatch table for the pair of types `(T_I, T_J)`: calls
+`func(typed_a, typed_b)` if `I <= J`, and `func(typed_b, typed_a)` otherwise. */
+template <std::size_t I, std::size_t J, typename Func, typename Arg>
+decltype(auto) symmetric_dispatch_thunk(Func &func, void *const *ptrs) {
+    using PtrI = typename Arg::template Pointer<I>;
+    using PtrJ = typename Arg::template Pointer<J>;
+    if constexpr (I <= J) {
+        return func(static_cast<PtrI>(ptrs[0]), static_cast<PtrJ>(ptrs[1]));
+    } else {
+        return func(static_cast<PtrJ>(ptrs[1]), static_cast<PtrI>(ptrs[0]));
+    }
+}
+
+/* `dispatch_table<Func, Args...>[C]` points to the thunk for the combination with index `C`. */
+template <typename Func, typename... Args, std::size_t... C>
+constexpr auto make_dispatch_table(std::index_sequence<C...>) {
+    using Thunk = DispatchResult<Func, Args...> (*)(Func&, void *const*);
+    return std::array<Thunk, sizeof...(C)>{&dispatch_thunk<C, Func, Args...>...};
+}
+
+template <typename Func, typename... Args>
+constexpr auto dispatch_table = make_dispatch_table<Func, Args...>(
+    std::make_index_sequence<(Args::num_types * ...)>{});
+
+/* `symmetric_dispatch_table<Func, Arg>[i * N + j]` points to the thunk for the pair of types
+`(T_i, T_j)`, where `N` is `Arg::num_types`. */
+template <typename Func, typename Arg, std::size_t... C>
+constexpr auto make_symmetric_dispatch_table(std::index_sequence<C...>) {
+    constexpr auto n = Arg::num_types;
+    using Result = decltype(symmetric_dispatch_thunk<0, 0, Func, Arg>(std::declval<Func&>(),
+                                                                      nullptr));
+    using Thunk = Result (*)(Func&, void *const*);
+    return std::array<Thunk, sizeof...(C)>{&symmetric_dispatch_thunk<C / n, C % n, Func, Arg>...};
+}
+
+template <typename Func, typename Arg>
+constexpr auto symmetric_dispatch_table = make_symmetric_dispatch_table<Func, Arg>(
+    std::make_index_sequence<Arg::num_types * Arg::num_types>{});
+
+/* Returns the address stored in `tagged_ptr`, as a `void*`. */
+template <typename TP>
+void *untagged_address(const TP &tagged_ptr) {
+    return reinterpret_cast<void*>(TaggedPointerAccess::bits(tagged_ptr)
+                                   & TaggedPointerAccess::ptr_mask<TP>());
+}
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Calls `func(typed_ptrs...)`, where each of `typed_ptrs...` is the pointer stored in the
+corresponding `TaggedPointer` (or type inheriting from one) in `tagged_ptrs...`, casted to its
+correct type (pointing to const iff that `TaggedPointer` is const), and returns the resulting
+value. `func` must be callable with every combination of types, and must return the same type for
+all of them. None of `tagged_ptrs...` may be null (this is checked with `assert`), as with `call`.
+
+The types are dispatched on with a single indirect call through a table of
+`N_1 * N_2 * ... * N_k` function pointers, indexed by the combined tags. */
+template <typename Func, typename... TPs>
+requires (sizeof...(TPs) > 0) && (detail::TaggedPointerLike<std::remove_cvref_t<TPs>> && ...)
+decltype(auto) dispatch(Func &&func, TPs &&...tagged_ptrs) {
+    constexpr auto &table = detail::dispatch_table<Func, detail::DispatchArgOf<TPs>...>;
+
+    assert(((tagged_ptrs.tag() != 0) && ...) && "Cannot `dispatch` on a tagged null pointer");
+    std::size_t index = 0;
+    ((index = index * detail::DispatchArgOf<TPs>::num_types + (tagged_ptrs.tag() - 1)), ...);
+
+    void *ptrs[] = {detail::untagged_address(tagged_ptrs)...};
+    return table[index](func, ptrs);
+}
+
+/* Calls `func(typed_a, typed_b)` if the type of `a` comes no later than the type of `b` in their
+common type pack, and `func(typed_b, typed_a)` otherwise, and returns the resulting value. Thus
+`func` only needs to be callable with the pairs of types `(T_i, T_j)` with `i <= j`, which suits
+symmetric operations such as collision tests. `a` and `b` must be of the same `TaggedPointer` type
+(both pointers passed to `func` point to const if either is const), and must not be null (this is
+checked with `assert`). */
+template <typename Func, typename TPA, typename TPB>
+requires detail::TaggedPointerLike<std::remove_cvref_t<TPA>>
+      && std::is_same_v<std::remove_cvref_t<TPA>, std::remove_cvref_t<TPB>>
+decltype(auto) dispatch_symmetric(Func &&func, TPA &&a, TPB &&b) {
+    using Arg = detail::DispatchArg<std::remove_cvref_t<TPA>,
+                                    std::is_const_v<std::remove_reference_t<TPA>>
+                                    || std::is_const_v<std::remove_reference_t<TPB>>>;
+    constexpr auto &table = detail::symmetric_dispatch_table<Func, Arg>;
+
+    assert(a.tag() != 0 && b.tag() != 0 && "Cannot `dispatch` on a tagged null pointer");
+    auto index = (a.tag() - 1) * Arg::num_types + (b.tag() - 1);
+
+    void *ptrs[] = {detail::untagged_address(a), detail::untagged_address(b)};
+    return table[index](func, ptrs);
+}
@@ -0,0 +1,157 @@
+/* Implements `NonNullTaggedPointer<Ts...>`, a `TaggedPointer<Ts...>` that can never be null.
+Because no tag needs to be reserved for `nullptr`, the tag of each type is its ZERO-indexed
+position within `Ts...`, and so `call` passes `tag()` to `detail::dispatch_call` directly
+instead of computing `tag() - 1`. */
+
+#pragma once
+
+#include <cassert>          // For `assert`
+#include <cstdint>          // For `uintptr_t`
+#include <utility>          // For `std::forward`
+#include "tagged_pointer.h"
+
+/* `NonNullTaggedPointer<Ts...>` represents a type-tagged, non-null pointer to one of the set of
+types specified by the parameter pack `Ts...`. */
+template <typename... Ts>
+class NonNullTaggedPointer {
+    using Access = detail::TaggedPointerAccess;
+
+    /* `NonNullTaggedPointer` uses the same layout as `TaggedPointer`; see the comments there. */
+    constexpr static unsigned TAG_SHIFT = Access::tag_shift<TaggedPointer<Ts...>>();
+    constexpr static uintptr_t GET_PTR_MASK = Access::ptr_mask<TaggedPointer<Ts...>>();
+
+    /* `NULLABLE_TAG_OFFSET` is the difference between the `tagged_address` of a `TaggedPointer`
+    and the `tagged_address` of a `NonNullTaggedPointer` to the same object; it is 1 (the
+    difference in tags) shifted left by `TAG_SHIFT`. */
+    constexpr static uintptr_t NULLABLE_TAG_OFFSET = static_cast<uintptr_t>(1) << TAG_SHIFT;
+
+    /* `tagged_address` is the address of the pointer, with the tag stored in the bits starting
+    from bit `TAG_SHIFT`, exactly as in `TaggedPointer`. */
+    uintptr_t tagged_address;
+
+    /* Constructs this `NonNullTaggedPointer` directly from `tagged_address`. */
+    struct FromBits {};
+    NonNullTaggedPointer(FromBits, uintptr_t tagged_address) : tagged_address{tagged_address} {}
+
+public:
+
+    /* Returns the number of types this `NonNullTaggedPointer` can point to. */
+    static constexpr auto num_types() {return sizeof...(Ts);}
+
+    /* Returns the tag of the type `T` in this `NonNullTaggedPointer<Ts...>`, which equals the
+    ZERO-indexed position of `T` within `Ts...`. Thus, the possible tags fall in the range
+    `[0, num_types())`. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    static constexpr unsigned get_tag_of_type() {return detail::IndexOfType_v<T, Ts...>;}
+
+    /* Returns the current tag of this `NonNullTaggedPointer`. */
+    auto tag() const {return static_cast<unsigned>(tagged_address >> TAG_SHIFT);}
+
+    /* Returns the address of the pointer stored in this `NonNullTaggedPointer` as a `void*`. */
+    const void *ptr() const {return reinterpret_cast<const void*>(tagged_address & GET_PTR_MASK);}
+    /* Returns the address of the pointer stored in this `NonNullTaggedPointer` as a `void*`. */
+    void *ptr() {return reinterpret_cast<void*>(tagged_address & GET_PTR_MASK);}
+
+    /* Returns the stored pointer casted to a `const T*` if the current type pointed to is `T`,
+    and returns `nullptr` otherwise. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    const T *cast() const {return points_to_type<T>() ? static_cast<const T*>(ptr()) : nullptr;}
+
+    /* Returns the stored pointer casted to a `T*` if the current type pointed to is `T`, and
+    returns `nullptr` otherwise. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    T *cast() {return points_to_type<T>() ? static_cast<T*>(ptr()) : nullptr;}
+
+    /* Returns the stored pointer casted to a `const T*`, without checking the current type. See
+    `TaggedPointer::cast_unchecked` for why we `static_cast` from `void*`. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    const T *cast_unchecked() const {return static_cast<const T*>(ptr());}
+
+    /* Returns the stored pointer casted to a `T*`, without checking the current type. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    T *cast_unchecked() {return static_cast<T*>(ptr());}
+
+    /* Returns `true` iff `T` is the type currently pointed to by this `NonNullTaggedPointer`. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    bool points_to_type() const {return tag() == get_tag_of_type<T>();}
+
+    /* Calls the function `func`, passing to it the pointer stored in this `NonNullTaggedPointer`,
+    casted to the correct type, and returns the resulting value. See `TaggedPointer::call`. Since
+    tags are zero-indexed here, `tag()` is passed to `dispatch_call` as-is. */
+    template <typename Func>
+    decltype(auto) call(Func &&func) {
+        return detail::dispatch_call_unified<Func, Ts...>(std::forward<Func>(func), ptr(), tag());
+    }
+
+    /* Calls the function `func`, passing to it the pointer stored in this `NonNullTaggedPointer`,
+    casted to the correct type, and returns the resulting value. See `TaggedPointer::call`. */
+    template <typename Func>
+    decltype(auto) call(Func &&func) const {
+        return detail::dispatch_call_unified<Func, Ts...>(std::forward<Func>(func), ptr(), tag());
+    }
+
+    /* Calls `func(typed_ptr, args...)`, where `typed_ptr` is the pointer stored in this
+    `NonNullTaggedPointer`, casted to the correct type. See `TaggedPointer::call(func, args...)`. */
+    template <typename Func, typename... Args>
+    requires (sizeof...(Args) > 0)
+    decltype(auto) call(Func &&func, Args &&...args) {
+        using Bound = detail::BoundCall<Func, Args...>;
+        return detail::dispatch_call_unified<Bound, Ts...>(
+            Bound{func, {std::forward<Args>(args)...}}, ptr(), tag());
+    }
+
+    /* Calls `func(typed_ptr, args...)`, where `typed_ptr` is the pointer stored in this
+    `NonNullTaggedPointer`, casted to the correct type. See `TaggedPointer::call(func, args...)`. */
+    template <typename Func, typename... Args>
+    requires (sizeof...(Args) > 0)
+    decltype(auto) call(Func &&func, Args &&...args) const {
+        using Bound = detail::BoundCall<Func, Args...>;
+        return detail::dispatch_call_unified<Bound, Ts...>(
+            Bound{func, {std::forward<Args>(args)...}}, ptr(), tag());
+    }
+
+    /* Two `NonNullTaggedPointer<Ts...>` are equal iff both their addresses and tags are equal. */
+    bool operator== (const NonNullTaggedPointer &other) const {
+        return tagged_address == other.tagged_address;
+    }
+
+    /* Two `NonNullTaggedPointer<Ts...>` are unequal iff their addresses or tags are unequal. */
+    bool operator!= (const NonNullTaggedPointer &other) const {
+        return tagged_address != other.tagged_address;
+    }
+
+    /* Converts this `NonNullTaggedPointer` to the (nullable) `TaggedPointer` pointing to the same
+    object. This is a single addition, as the tags of the two differ by exactly 1. */
+    operator TaggedPointer<Ts...>() const {
+        return Access::from_bits<TaggedPointer<Ts...>>(tagged_address + NULLABLE_TAG_OFFSET);
+    }
+
+    /* Returns the `NonNullTaggedPointer` pointing to the same object as `tagged_ptr`, which must
+    not be null (this is checked with `assert`). */
+    static NonNullTaggedPointer from_nullable(const TaggedPointer<Ts...> &tagged_ptr) {
+        assert(tagged_ptr.tag() != 0 && "Cannot create a `NonNullTaggedPointer` from `nullptr`");
+        return {FromBits{}, Access::bits(tagged_ptr) - NULLABLE_TAG_OFFSET};
+    }
+
+    /* Constructs this `NonNullTaggedPointer` from `ptr`, a pointer to `T`. `T` is required to
+    be one of the types in the parameter pack `Ts...`, and `ptr` must not be null (this is
+    checked with `assert`). See `TaggedPointer::TaggedPointer(const T*)`. */
+    template <typename T>
+    requires detail::ContainsType<T, Ts...>
+    NonNullTaggedPointer(const T *ptr)
+        : tagged_address{reinterpret_cast<uintptr_t>(static_cast<const void*>(ptr))
+                       | (static_cast<uintptr_t>(get_tag_of_type<T>()) << TAG_SHIFT)}
+    {
+        assert(ptr != nullptr && "Cannot create a `NonNullTaggedPointer` from `nullptr`");
+    }
+
+    /* Constructing a `NonNullTaggedPointer` from the literal `nullptr` is a compile-time
+    error. */
+    NonNullTaggedPointer(std::nullptr_t) = delete;
+};
@@ -0,0 +1,188 @@
+/* Implements `RunIndex<TP>`, an index of the runs of consecutive elements with the same tag in an
+array of `TaggedPointer`s. Arrays that are mostly sorted by type (for instance, because objects are
+created in batches of one type) consist of a few long runs, and for those, `for_each_run` calls a
+function once per run, passing it a `TypedRun<T>`: a zero-copy view of the run that yields `T*`s.
+Thus the tag is dispatched on once per run instead of once per element, and no pointers are moved,
+unlike with `partition_by_tag`.
+
+The index is built from the tags extracted by the SIMD kernels of `tagged_pointer_bulk.h`, and is
+kept up to date as elements are appended to the indexed array with `append` and `extend`. It is
+NOT updated when elements of the indexed array are modified or removed; in that case, `clear` the
+index and `extend` it with the whole array again. */
+
+#pragma once
+
+#include <cassert>          // For `assert`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`, `uint8_t`, `uint64_t`
+#include <cstring>          // For `std::memcpy`
+#include <span>             // For `std::span`
+#include <type_traits>      // For `std::remove_pointer_t`
+#include <utility>          // For `std::as_const`
+#include <vector>           // For `std::vector`
+#include "tagged_pointer.h"
+#include "tagged_pointer_bulk.h"
+
+/* `TagRun` is a maximal run of `length` consecutive elements with tag `tag`, starting at index
+`begin`. */
+struct TagRun {
+    unsigned tag;
+    std::size_t begin;
+    std::size_t length;
+};
+
+/* `TypedRun<T>` is a view of consecutive `TaggedPointer`s that all point to a `T` (or, if `T` is
+const-qualified, to a `const T`). Indexing and iterating yield the `T*`s themselves, which are
+found by masking out the tag bits of each element on the fly. */
+template <typename T>
+class TypedRun {
+    /* `PTR_MASK` keeps the address bits of a `tagged_address`; see `TaggedPointer`. */
+    constexpr static uintptr_t PTR_MASK = detail::TaggedPointerAccess::ptr_mask<TaggedPointer<>>();
+
+    /* `words` points to the `tagged_address` of the first element of the run. */
+    const uintptr_t *words;
+    std::size_t count;
+
+public:
+
+    /* `iterator` is a forward iterator over the `T*`s of a `TypedRun`. */
+    class iterator {
+        const uintptr_t *word;
+
+    public:
+        explicit iterator(const uintptr_t *word) : word{word} {}
+        T *operator*() const {return reinterpret_cast<T*>(*word & PTR_MASK);}
+        iterator &operator++() {++word; return *this;}
+        iterator operator++(int) {auto old = *this; ++word; return old;}
+        bool operator== (const iterator &other) const {return word == other.word;}
+        bool operator!= (const iterator &other) const {return word != other.word;}
+    };
+
+    /* Returns the number of elements in this run. */
+    std::size_t size() const {return count;}
+
+    /* Returns the `i`th pointer of this run. */
+    T *operator[](std::size_t i) const {return reinterpret_cast<T*>(words[i] & PTR_MASK);}
+
+    iterator begin() const {return iterator{words};}
+    iterator end() const {return iterator{words + count};}
+
+    /* Constructs a `TypedRun` over the `count` elements whose `tagged_address`es start at
+    `words`. */
+    TypedRun(const uintptr_t *words, std::size_t count) : words{words}, count{count} {}
+};
+
+/* `RunIndex<TP>` indexes the runs of equal tags in an array of `TP`s, where `TP` is a
+`TaggedPointer` (or a type that inherits from one). */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+class RunIndex {
+    using Access = detail::TaggedPointerAccess;
+
+    /* `tag_runs` holds the runs of the indexed elements, in order. Consecutive runs always have
+    different tags. */
+    std::vector<TagRun> tag_runs;
+
+    /* `num_elements` is the number of indexed elements; the sum of the lengths of all runs. */
+    std::size_t num_elements = 0;
+
+    /* Appends `length` elements with tag `tag` to this index, merging them into the last run if it
+    has the same tag. */
+    void push_run(unsigned tag, std::size_t length) {
+        if (!tag_runs.empty() && tag_runs.back().tag == tag) {
+            tag_runs.back().length += length;
+        } else {
+            tag_runs.push_back({tag, num_elements, length});
+        }
+        num_elements += length;
+    }
+
+    /* Calls `func` once per run of non-null pointers of `words`, passing it a `TypedRun<T>`
+    (or a `TypedRun<const T>`, iff `IsConst` is `true`) over the run, where `T` is the type the
+    run points to. The type is found with a single `call` on a pointer with the run's tag. */
+    template <bool IsConst, typename Func>
+    void for_each_run_impl(const uintptr_t *words, Func &&func) const {
+        for (const auto &run : tag_runs) {
+            if (run.tag == 0) {continue;}
+            auto typed = [&](auto *ptr) {
+                func(TypedRun<std::remove_pointer_t<decltype(ptr)>>{words + run.begin, run.length});
+            };
+            auto tag_only = Access::from_bits<TP>(static_cast<uintptr_t>(run.tag)
+                                                  << Access::tag_shift<TP>());
+            if constexpr (IsConst) {
+                std::as_const(tag_only).call(typed);
+            } else {
+                tag_only.call(typed);
+            }
+        }
+    }
+
+public:
+
+    /* Returns the runs of the indexed elements, in order. */
+    const std::vector<TagRun> &runs() const {return tag_runs;}
+
+    /* Returns the number of indexed elements. */
+    std::size_t size() const {return num_elements;}
+
+    /* Adds `tagged_ptr`, which has just been appended to the indexed array, to this index. */
+    void append(const TP &tagged_ptr) {push_run(tagged_ptr.tag(), 1);}
+
+    /* Adds `tagged_ptrs`, which have just been appended to the indexed array, to this index. Tags
+    are extracted one block at a time with the SIMD kernels, and each run is then skipped over
+    eight tags at a time. */
+    void extend(std::span<const TP> tagged_ptrs) {
+        auto words = detail::words_of(tagged_ptrs);
+        auto n = tagged_ptrs.size();
+        uint8_t tags[detail::BULK_BLOCK_SIZE];
+        for (std::size_t i = 0; i < n; i += detail::BULK_BLOCK_SIZE) {
+            auto block_size = n - i < detail::BULK_BLOCK_SIZE ? n - i : detail::BULK_BLOCK_SIZE;
+            detail::extract_tags(words + i, block_size, tags);
+
+            std::size_t j = 0;
+            while (j < block_size) {
+                auto tag = tags[j];
+                auto run_begin = j++;
+                /* `pattern` is 8 copies of `tag`, to compare against 8 tags at once. */
+                auto pattern = uint64_t{tag} * 0x0101010101010101;
+                for (uint64_t next; j + 8 <= block_size; j += 8) {
+                    std::memcpy(&next, tags + j, sizeof(next));
+                    if (next != pattern) {break;}
+                }
+                while (j < block_size && tags[j] == tag) {++j;}
+                push_run(tag, j - run_begin);
+            }
+        }
+    }
+
+    /* Empties this index. */
+    void clear() {
+        tag_runs.clear();
+        num_elements = 0;
+    }
+
+    /* Calls `func` once per run of pointers to the same type in `tagged_ptrs`, which must be the
+    indexed array, passing it a `TypedRun<T>`, where `T` is the type the run points to. Thus `func`
+    must be callable with a `TypedRun<T>` for every type `T` `TP` can point to; a generic lambda
+    such as `[](auto run) {for (auto *ptr : run) {...}}` is typical. Runs of null pointers are
+    skipped. */
+    template <typename Func>
+    void for_each_run(std::span<TP> tagged_ptrs, Func &&func) const {
+        assert(tagged_ptrs.size() == num_elements && "`RunIndex` is out of date");
+        for_each_run_impl<false>(detail::words_of(tagged_ptrs), func);
+    }
+
+    /* Calls `func` once per run of pointers to the same type in `tagged_ptrs`, which must be the
+    indexed array, passing it a `TypedRun<const T>`, where `T` is the type the run points to. */
+    template <typename Func>
+    void for_each_run(std::span<const TP> tagged_ptrs, Func &&func) const {
+        assert(tagged_ptrs.size() == num_elements && "`RunIndex` is out of date");
+        for_each_run_impl<true>(detail::words_of(tagged_ptrs), func);
+    }
+
+    /* Constructs an empty `RunIndex`. */
+    RunIndex() = default;
+
+    /* Constructs the `RunIndex` of `tagged_ptrs`. */
+    explicit RunIndex(std::span<const TP> tagged_ptrs) {extend(tagged_ptrs);}
+};
@@ -0,0 +1,255 @@
+/* Implements `TagSequenceAnalyzer<TP>`, which measures the sequence of tags seen by a call site (or
+stored in an array of `TaggedPointer`s), and estimates which of the dispatch optimizations of this
+library is worth applying to it:
+- If one or two types account for nearly all calls, an `InlineCache` (see inline_cache.h), or a
+  `hot` hint, turns most dispatches into a well-predicted comparison.
+- Otherwise, if the tags already come in long runs, dispatching once per run with a `RunIndex` (see
+  run_index.h) avoids most dispatches, without moving anything.
+- Otherwise, if the next tag is hard to predict from the previous one, the branch predictor misses
+  on a large fraction of dispatches, and sorting by tag first (with `partition_by_tag` or a
+  `CommandBuffer`; see tagged_pointer_bulk.h and command_buffer.h) pays for itself.
+- Otherwise, the sequence follows a pattern the branch predictor learns, and plain `call` is best.
+
+These estimates are made from the distribution of tags and of transitions between consecutive
+tags: the entropy of the tags, and the conditional entropy of each tag given the previous one (in
+bits), along with the average length of the runs of equal tags. A `SampledTagObserver<TP>` feeds
+an analyzer with short bursts of consecutive calls, one burst every so many calls, so that a live
+call site can be analyzed in production at the cost of a decrement and a branch per call. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cassert>          // For `assert`
+#include <cmath>            // For `std::log2`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uint8_t`, `uint64_t`
+#include <span>             // For `std::span`
+#include <vector>           // For `std::vector`
+#include "tagged_pointer.h"
+#include "tagged_pointer_bulk.h"
+
+/* `TagSequenceAdvice` is the dispatch optimization a `TagSequenceAnalyzer` recommends; see the top
+of this file. */
+enum class TagSequenceAdvice {Call, InlineCache, RunBatching, SortByTag};
+
+/* Returns the name of `advice`, as written in its declaration. */
+inline const char *tag_sequence_advice_name(TagSequenceAdvice advice) {
+    switch (advice) {
+        case TagSequenceAdvice::Call: return "Call";
+        case TagSequenceAdvice::InlineCache: return "InlineCache";
+        case TagSequenceAdvice::RunBatching: return "RunBatching";
+        default: return "SortByTag";
+    }
+}
+
+/* `TagSequenceAnalysis` holds the statistics of a sequence of tags of a `TaggedPointer` with
+`num_tags - 1` types:
+- `length` is the number of tags observed, and `tag_probabilities[tag]` the fraction of them equal
+  to `tag`.
+- `transition_probabilities[from * num_tags + to]` is the probability that a tag `from` is
+  followed by a tag `to` (0 if `from` was never followed by anything).
+- `average_run_length` is the average length of the runs of equal consecutive tags.
+- `entropy` is the entropy of the tags, and `conditional_entropy` the entropy of a tag given the
+  previous one, both in bits.
+- `top_share` and `top_two_share` are the fractions of non-null tags equal to the most frequent
+  non-null tag, and to either of the two most frequent ones. Null tags are left out, as an
+  `InlineCache` never caches them (`call` must not be used on tagged null pointers anyway). */
+struct TagSequenceAnalysis {
+    unsigned num_tags;
+    uint64_t length;
+    std::vector<double> tag_probabilities;
+    std::vector<double> transition_probabilities;
+    double average_run_length;
+    double entropy;
+    double conditional_entropy;
+    double top_share;
+    double top_two_share;
+    TagSequenceAdvice advice;
+};
+
+/* `TagSequenceAnalyzer<TP>` accumulates the statistics of a sequence of tags of `TP`s, where `TP`
+is a `TaggedPointer` (or a type that inherits from one). It is not thread-safe. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+class TagSequenceAnalyzer {
+    constexpr static unsigned NUM_TAGS = TP::num_types() + 1;
+
+    /* `NO_TAG` is the previous tag at the start of a sequence; it never equals a real tag. */
+    constexpr static unsigned NO_TAG = ~0u;
+
+    /* The share of calls one or two types must account for to recommend an `InlineCache`; the
+    same as the threshold of `InlineCache` itself. */
+    constexpr static double MIN_INLINE_CACHE_SHARE = 15.0 / 16.0;
+
+    /* The average run length from which dispatching once per run is recommended. */
+    constexpr static double MIN_BATCH_RUN_LENGTH = 8.0;
+
+    /* The conditional entropy (in bits) from which sorting by tag is recommended: beyond one bit,
+    the next tag is less predictable from the previous one than a fair coin flip. */
+    constexpr static double MIN_SORT_CONDITIONAL_ENTROPY = 1.0;
+
+    std::array<uint64_t, NUM_TAGS> tag_counts{};
+    std::array<uint64_t, NUM_TAGS * NUM_TAGS> transition_counts{};
+    uint64_t num_runs = 0;
+    unsigned last_tag = NO_TAG;
+
+    /* Returns `-p * log2(p)`, or 0 if `p` is 0. */
+    static double entropy_term(double p) {return p > 0 ? -p * std::log2(p) : 0.0;}
+
+public:
+
+    /* Adds the tag of `tagged_ptr` to the observed sequence. */
+    void observe(const TP &tagged_ptr) {observe_tag(tagged_ptr.tag());}
+
+    /* Adds `tag` to the observed sequence. */
+    void observe_tag(unsigned tag) {
+        ++tag_counts[tag];
+        if (tag != last_tag) {++num_runs;}
+        if (last_tag != NO_TAG) {++transition_counts[last_tag * NUM_TAGS + tag];}
+        last_tag = tag;
+    }
+
+    /* Adds the tags of `tagged_ptrs` to the observed sequence, extracting them one block at a time
+    with the SIMD kernels of tagged_pointer_bulk.h. */
+    void observe(std::span<const TP> tagged_ptrs) {
+        auto words = detail::words_of(tagged_ptrs);
+        auto n = tagged_ptrs.size();
+        uint8_t tags[detail::BULK_BLOCK_SIZE];
+        for (std::size_t i = 0; i < n; i += detail::BULK_BLOCK_SIZE) {
+            auto block_size = n - i < detail::BULK_BLOCK_SIZE ? n - i : detail::BULK_BLOCK_SIZE;
+            detail::extract_tags(words + i, block_size, tags);
+            for (std::size_t j = 0; j < block_size; ++j) {observe_tag(tags[j]);}
+        }
+    }
+
+    /* Marks a gap in the observed sequence: the next tag observed starts a new run, and is not
+    counted as a transition from the last one. */
+    void break_sequence() {last_tag = NO_TAG;}
+
+    /* Forgets everything observed so far. */
+    void reset() {
+        tag_counts.fill(0);
+        transition_counts.fill(0);
+        num_runs = 0;
+        last_tag = NO_TAG;
+    }
+
+    /* Returns the statistics of the sequence observed so far, and the resulting advice. */
+    TagSequenceAnalysis analysis() const {
+        TagSequenceAnalysis result{NUM_TAGS, 0, std::vector<double>(NUM_TAGS),
+                                   std::vector<double>(NUM_TAGS * NUM_TAGS), 0, 0, 0, 0, 0,
+                                   TagSequenceAdvice::Call};
+        for (auto count : tag_counts) {result.length += count;}
+        if (result.length == 0) {return result;}
+        auto length = static_cast<double>(result.length);
+
+        for (unsigned tag = 0; tag < NUM_TAGS; ++tag) {
+            auto p = static_cast<double>(tag_counts[tag]) / length;
+            result.tag_probabilities[tag] = p;
+            result.entropy += entropy_term(p);
+        }
+
+        uint64_t first_count = 0, second_count = 0;
+        for (unsigned tag = 1; tag < NUM_TAGS; ++tag) {
+            if (tag_counts[tag] > first_count) {
+                second_count = first_count;
+                first_count = tag_counts[tag];
+            } else if (tag_counts[tag] > second_count) {
+                second_count = tag_counts[tag];
+            }
+        }
+        if (auto non_null = static_cast<double>(result.length - tag_counts[0]); non_null > 0) {
+            result.top_share = static_cast<double>(first_count) / non_null;
+            result.top_two_share = static_cast<double>(first_count + second_count) / non_null;
+        }
+        result.average_run_length = length / static_cast<double>(num_runs);
+
+        /* H(next | previous) = sum over `from` of P(from) * H(next | previous = from), where
+        P(from) is the share of transitions leaving `from`. */
+        uint64_t num_transitions = 0;
+        for (auto count : transition_counts) {num_transitions += count;}
+        for (unsigned from = 0; from < NUM_TAGS; ++from) {
+            uint64_t row_count = 0;
+            for (unsigned to = 0; to < NUM_TAGS; ++to) {
+                row_count += transition_counts[from * NUM_TAGS + to];
+            }
+            if (row_count == 0) {continue;}
+            double row_entropy = 0;
+            for (unsigned to = 0; to < NUM_TAGS; ++to) {
+                auto p = static_cast<double>(transition_counts[from * NUM_TAGS + to])
+                       / static_cast<double>(row_count);
+                result.transition_probabilities[from * NUM_TAGS + to] = p;
+                row_entropy += entropy_term(p);
+            }
+            result.conditional_entropy += static_cast<double>(row_count)
+                                        / static_cast<double>(num_transitions) * row_entropy;
+        }
+
+        if (result.top_two_share >= MIN_INLINE_CACHE_SHARE) {
+            result.advice = TagSequenceAdvice::InlineCache;
+        } else if (result.average_run_length >= MIN_BATCH_RUN_LENGTH) {
+            result.advice = TagSequenceAdvice::RunBatching;
+        } else if (result.conditional_entropy >= MIN_SORT_CONDITIONAL_ENTROPY) {
+            result.advice = TagSequenceAdvice::SortByTag;
+        }
+        return result;
+    }
+};
+
+/* `DEFAULT_SAMPLE_PERIOD` and `DEFAULT_SAMPLE_BURST` are the default number of calls between the
+starts of two bursts observed by a `SampledTagObserver`, and the default length of each burst. */
+constexpr unsigned DEFAULT_SAMPLE_PERIOD = 4096;
+constexpr unsigned DEFAULT_SAMPLE_BURST = 64;
+
+/* `SampledTagObserver<TP>` feeds a `TagSequenceAnalyzer<TP>` with a burst of `burst_length`
+consecutive tags out of every `period` tags it is given, so that transitions and runs are still
+measured within each burst. It is meant to be declared `thread_local` at the call site it observes:
+
+    double Shape::get_area() const {
+        thread_local SampledTagObserver<Shape> observer;
+        observer.observe(*this);
+        return call([](auto ptr) {return ptr->get_area();});
+    }
+
+Runs are cut at the end of each burst, so `average_run_length` is at most `burst_length`. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+class SampledTagObserver {
+    TagSequenceAnalyzer<TP> tag_analyzer;
+    unsigned skip_length;
+    unsigned burst_length;
+    unsigned skip_left = 0;
+    unsigned burst_left;
+
+public:
+
+    /* Constructs a `SampledTagObserver` observing `burst_length` consecutive tags out of every
+    `period`, starting with the first tag. `burst_length` is at least 1, and at most `period`. */
+    explicit SampledTagObserver(unsigned period = DEFAULT_SAMPLE_PERIOD,
+                                unsigned burst_length = DEFAULT_SAMPLE_BURST)
+        : skip_length(period - burst_length), burst_length(burst_length),
+          burst_left(burst_length) {
+        assert(0 < burst_length && burst_length <= period
+               && "`burst_length` must be at least 1, and at most `period`");
+    }
+
+    /* Observes the tag of `tagged_ptr`, if it falls within a burst. */
+    void observe(const TP &tagged_ptr) {
+        if (skip_left != 0) [[likely]] {
+            --skip_left;
+            return;
+        }
+        tag_analyzer.observe(tagged_ptr);
+        if (--burst_left == 0) {
+            tag_analyzer.break_sequence();
+            skip_left = skip_length;
+            burst_left = burst_length;
+        }
+    }
+
+    /* Returns the analyzer fed by this observer. */
+    const TagSequenceAnalyzer<TP> &analyzer() const {return tag_analyzer;}
+
+    /* Returns the analyzer fed by this observer, for instance to `reset` it. */
+    TagSequenceAnalyzer<TP> &analyzer() {return tag_analyzer;}
+};
@@ -0,0 +1,179 @@
+/* Implements `TaggedOptional<TP>` and `TaggedResult<TP, E>`, an optional `TaggedPointer` and a
+`TaggedPointer`-or-error-code, respectively. A `TaggedPointer<Ts...>` only ever uses the tags in
+`[0, num_types()]`, so both types encode their extra state (being empty, or holding an error) in
+the unused tag `max_tag()`. As a result, both are exactly as large as the `TaggedPointer` they
+hold, unlike `std::optional<TaggedPointer<Ts...>>`, which needs a separate `bool`. */
+
+#pragma once
+
+#include <cstdint>          // For `uintptr_t`
+#include <optional>         // For `std::nullopt_t`, `std::bad_optional_access`
+#include <type_traits>      // For `std::underlying_type_t`, `std::make_unsigned_t`
+#include "tagged_pointer.h"
+
+/* `TaggedOptional<TP>` either holds a `TP` (a `TaggedPointer<Ts...>`, or a type that inherits
+from one), or is empty. Note that a `TaggedOptional` holding a tagged null pointer is NOT empty;
+this mirrors `std::optional<T*>`. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+class TaggedOptional {
+    using Access = detail::TaggedPointerAccess;
+
+    static_assert(TP::num_types() < TP::max_tag(), "`TaggedOptional` needs an unused tag");
+    static_assert(sizeof(TP) == sizeof(uintptr_t), "`TP` must not add any data members");
+
+    /* `EMPTY_BITS` is the `tagged_address` of an empty `TaggedOptional`: the tag bits are set to
+    `max_tag()`, and the address bits are zero. Because `max_tag()` is the largest possible tag,
+    every non-empty `TaggedOptional` has a `tagged_address` strictly less than `EMPTY_BITS`. */
+    constexpr static uintptr_t EMPTY_BITS = static_cast<uintptr_t>(TP::max_tag())
+                                          << Access::tag_shift<TP>();
+
+    /* `stored` holds the value of this `TaggedOptional`, or `EMPTY_BITS` if it is empty. */
+    TP stored;
+
+public:
+
+    /* Returns `true` iff this `TaggedOptional` holds a value. This compiles down to a single
+    comparison of the stored `tagged_address` with `EMPTY_BITS` (see above). */
+    bool has_value() const {return Access::bits(stored) < EMPTY_BITS;}
+
+    /* Returns `true` iff this `TaggedOptional` holds a value. */
+    explicit operator bool() const {return has_value();}
+
+    /* Returns the held value. Does not check that this `TaggedOptional` holds a value. */
+    TP &operator*() {return stored;}
+    /* Returns the held value. Does not check that this `TaggedOptional` holds a value. */
+    const TP &operator*() const {return stored;}
+
+    /* Returns a pointer to the held value. Does not check that this `TaggedOptional` holds a
+    value. */
+    TP *operator->() {return &stored;}
+    /* Returns a pointer to the held value. Does not check that this `TaggedOptional` holds a
+    value. */
+    const TP *operator->() const {return &stored;}
+
+    /* Returns the held value, throwing `std::bad_optional_access` if this `TaggedOptional` is
+    empty. */
+    TP &value() {
+        if (!has_value()) {throw std::bad_optional_access{};}
+        return stored;
+    }
+
+    /* Returns the held value, throwing `std::bad_optional_access` if this `TaggedOptional` is
+    empty. */
+    const TP &value() const {
+        if (!has_value()) {throw std::bad_optional_access{};}
+        return stored;
+    }
+
+    /* Returns the held value if this `TaggedOptional` holds one, and `default_value` otherwise. */
+    TP value_or(const TP &default_value) const {return has_value() ? stored : default_value;}
+
+    /* Makes this `TaggedOptional` empty. */
+    void reset() {Access::set_bits(stored, EMPTY_BITS);}
+
+    /* Two `TaggedOptional`s are equal iff both are empty, or both hold equal values. */
+    bool operator== (const TaggedOptional &other) const {
+        return Access::bits(stored) == Access::bits(other.stored);
+    }
+
+    /* Two `TaggedOptional`s are unequal iff exactly one is empty, or both hold unequal values. */
+    bool operator!= (const TaggedOptional &other) const {
+        return Access::bits(stored) != Access::bits(other.stored);
+    }
+
+    /* Constructs this `TaggedOptional` to hold `value`. */
+    TaggedOptional(const TP &value) : stored{value} {}
+
+    /* Constructs an empty `TaggedOptional`. */
+    TaggedOptional(std::nullopt_t) : stored{Access::from_bits<TP>(EMPTY_BITS)} {}
+
+    /* The default constructor for `TaggedOptional` constructs an empty `TaggedOptional`. */
+    TaggedOptional() : TaggedOptional(std::nullopt) {}
+};
+
+/* `TaggedResult<TP, E>` either holds a `TP` (a `TaggedPointer<Ts...>`, or a type that inherits
+from one), or an error code of type `E`, where `E` is an enumeration or integral type of at most
+32 bits. An error is encoded by setting the tag bits to `max_tag()`, and storing the error code
+itself in the address bits. */
+template <typename TP, typename E>
+requires detail::TaggedPointerLike<TP> && (std::is_enum_v<E> || std::is_integral_v<E>)
+class TaggedResult {
+    using Access = detail::TaggedPointerAccess;
+
+    static_assert(TP::num_types() < TP::max_tag(), "`TaggedResult` needs an unused tag");
+    static_assert(sizeof(TP) == sizeof(uintptr_t), "`TP` must not add any data members");
+    static_assert(sizeof(E) <= sizeof(uint32_t) && !std::is_same_v<E, bool>,
+                  "Error codes must fit in the address bits of a `TaggedPointer`");
+
+    /* `ErrorBits` is the unsigned integral type with the same size as `E` (or as the underlying
+    type of `E`, if `E` is an enumeration). Error codes are converted to `ErrorBits` before
+    being stored, so that negative error codes do not spill into the tag bits. */
+    using ErrorBits = std::make_unsigned_t<
+        typename std::conditional_t<std::is_enum_v<E>, std::underlying_type<E>,
+                                    std::type_identity<E>>::type>;
+
+    /* `ERROR_BITS` is the `tagged_address` of a `TaggedResult` holding the error code whose
+    `ErrorBits` are all zero. Every `TaggedResult` holding a value has a `tagged_address`
+    strictly less than `ERROR_BITS`, and every `TaggedResult` holding an error has a
+    `tagged_address` greater than or equal to `ERROR_BITS`. */
+    constexpr static uintptr_t ERROR_BITS = static_cast<uintptr_t>(TP::max_tag())
+                                          << Access::tag_shift<TP>();
+
+    /* `stored` holds the value of this `TaggedResult`, or `ERROR_BITS` combined with the held
+    error code. */
+    TP stored;
+
+    /* Constructs this `TaggedResult` directly from `tagged_address`. Used by `from_error`. */
+    explicit TaggedResult(uintptr_t tagged_address)
+        : stored{Access::from_bits<TP>(tagged_address)} {}
+
+public:
+
+    /* Returns `true` iff this `TaggedResult` holds a value (and not an error). This compiles down
+    to a single comparison of the stored `tagged_address` with `ERROR_BITS` (see above). */
+    bool has_value() const {return Access::bits(stored) < ERROR_BITS;}
+
+    /* Returns `true` iff this `TaggedResult` holds a value (and not an error). */
+    explicit operator bool() const {return has_value();}
+
+    /* Returns the held value. Does not check that this `TaggedResult` holds a value. */
+    TP &operator*() {return stored;}
+    /* Returns the held value. Does not check that this `TaggedResult` holds a value. */
+    const TP &operator*() const {return stored;}
+
+    /* Returns a pointer to the held value. Does not check that this `TaggedResult` holds a
+    value. */
+    TP *operator->() {return &stored;}
+    /* Returns a pointer to the held value. Does not check that this `TaggedResult` holds a
+    value. */
+    const TP *operator->() const {return &stored;}
+
+    /* Returns the held value if this `TaggedResult` holds one, and `default_value` otherwise. */
+    TP value_or(const TP &default_value) const {return has_value() ? stored : default_value;}
+
+    /* Returns the held error code. Does not check that this `TaggedResult` holds an error. */
+    E error() const {
+        return static_cast<E>(static_cast<ErrorBits>(Access::bits(stored)));
+    }
+
+    /* Two `TaggedResult`s are equal iff they hold equal values, or equal error codes. */
+    bool operator== (const TaggedResult &other) const {
+        return Access::bits(stored) == Access::bits(other.stored);
+    }
+
+    /* Two `TaggedResult`s are unequal iff exactly one holds an error, or they hold unequal values
+    or unequal error codes. */
+    bool operator!= (const TaggedResult &other) const {
+        return Access::bits(stored) != Access::bits(other.stored);
+    }
+
+    /* Constructs this `TaggedResult` to hold `value`. */
+    TaggedResult(const TP &value) : stored{value} {}
+
+    /* Returns a `TaggedResult` holding the error code `error`. This is a named function rather
+    than a constructor so that an integral `E` can never be confused with a pointer. */
+    static TaggedResult from_error(E error) {
+        return TaggedResult{ERROR_BITS | static_cast<uintptr_t>(static_cast<ErrorBits>(error))};
+    }
+};
@@ -2,11 +2,23 @@
 runtime polymorphism while avoiding the traditional storage overhead from virtual function
 table pointers, which are stored for all pointers to an abstract base class. */
 
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cstddef>          // For `std::ptrdiff_t`, `std::byte`
 #include <cstdint>          // For `uintptr_t`
-#include <type_traits>      // For `std::integral_constant`, `std::disjunction_v`
-#include <utility>          // For `std::forward`
+#include <optional>         // For `std::optional`
+#include <string_view>      // For `std::string_view`
+#include <tuple>            // For `std::tuple`, `std::apply`, `std::tuple_element_t`
+#include <type_traits>      // For `std::integral_constant`, `std::common_type`
+#include <utility>          // For `std::forward`, `std::index_sequence`
+#include <variant>          // For `std::monostate`
 #include "dispatch_call.h"
 
+#ifdef TAGGED_POINTER_INSTRUMENT
+#include "tagged_pointer_instrument.h"
+#endif
+
 namespace detail {
 
 /* `IndexOfType` is a helper class that enables us to find the index of the type `T` within
@@ -37,6 +49,318 @@ constexpr unsigned IndexOfType_v = IndexOfType<T, Ts...>::value;
 template <typename T, typename... Ts>
 concept ContainsType = (std::is_same_v<T, Ts> || ...);
 
+/* `TaggedPointerAccess` grants the rest of this library access to the raw `tagged_address` of a
+`TaggedPointer`; see its definition below the definition of `TaggedPointer`. */
+struct TaggedPointerAccess;
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `TypeCategory<Ts...>` names a set of types, so that a `TaggedPointer` can be asked whether it
+points to any type in the set, and can dispatch over only that set. For instance, after
+
+    using Round = TypeCategory<Circle, Ellipse, Sphere>;
+
+`tagged_ptr.points_to_any<Round>()` checks whether `tagged_ptr` points to a `Circle`, `Ellipse`, or
+`Sphere`. Categories may be nested in other categories, and mixed with plain types. */
+template <typename... Ts>
+struct TypeCategory {};
+
+/* `hot<Hs...>` declares that the types `Hs...` account for most calls at a call site, in order of
+decreasing frequency. Passing it to `call`, as in `tagged_ptr.call(hot<Circle, Rectangle>{}, func)`,
+makes `call` test for those types first, and move the dispatch over all other types out of line.
+This only pays off when the hot types are very common: in bench/hot_bench.cpp, with 8 types, it is
+about 25-40% faster than `call` when one type accounts for 95% or more of the calls, but no faster
+(and often slower) at 80% or less, where the extra compare only adds a mispredicted branch. Measure
+the skew of a call site (see tag_sequence_analyzer.h) before declaring types hot. */
+template <typename... Hs>
+struct hot {};
+
+/* `TaggedTypeInfo` describes one of the types a `TaggedPointer` can point to; see
+`TaggedPointer::type_info`. `name` is the name of the type as spelled by the compiler (or
+`"unknown"` on compilers other than GCC, Clang and MSVC). */
+struct TaggedTypeInfo {
+    std::size_t size;
+    std::size_t alignment;
+    std::string_view name;
+    bool is_trivially_destructible;
+    bool is_trivially_copyable;
+};
+
+namespace detail {
+
+/* `ConcatCategories<Cs...>::type` is the `TypeCategory` holding the types of all of the
+`TypeCategory`s `Cs...`, in order. */
+template <typename... Cs>
+struct ConcatCategories {using type = TypeCategory<>;};
+
+template <typename... As>
+struct ConcatCategories<TypeCategory<As...>> {using type = TypeCategory<As...>;};
+
+template <typename... As, typename... Bs, typename... Cs>
+struct ConcatCategories<TypeCategory<As...>, TypeCategory<Bs...>, Cs...>
+    : public ConcatCategories<TypeCategory<As..., Bs...>, Cs...> {};
+
+template <typename... Ts>
+struct FlattenCategories;
+
+/* `AsCategory<T>::type` is `TypeCategory<T>` for a plain type `T`, and is the flattened
+category for a `TypeCategory`. */
+template <typename T>
+struct AsCategory {using type = TypeCategory<T>;};
+
+template <typename... Ts>
+struct AsCategory<TypeCategory<Ts...>> {using type = typename FlattenCategories<Ts...>::type;};
+
+/* `FlattenCategories<Ts...>::type` is the `TypeCategory` of all plain types in `Ts...`, where
+every `TypeCategory` in `Ts...` (at any nesting depth) is replaced by its types. */
+template <typename... Ts>
+struct FlattenCategories
+    : public ConcatCategories<typename AsCategory<Ts>::type...> {};
+
+/* `FlattenCategories_t<Ts...>` equals `FlattenCategories<Ts...>::type`. */
+template <typename... Ts>
+using FlattenCategories_t = typename FlattenCategories<Ts...>::type;
+
+/* `IsNonVirtualBaseOf<Base, T>` is satisfied iff `Base` is an accessible, unambiguous, non-virtual
+base class of `T` (or is `T` itself). Only then is the offset of the `Base` subobject within a `T`
+the same for every `T`, which is what `base_offset_of_tag` relies on. */
+template <typename Base, typename T>
+concept IsNonVirtualBaseOf = std::is_convertible_v<T*, Base*>
+                          && requires (Base *base) {static_cast<T*>(base);};
+
+/* Returns the offset, in bytes, of the `Base` subobject within a `T`, or 0 if `Base` is not a
+base class of `T`. This is computed by upcasting a pointer to suitably sized and aligned local
+storage, so that no `T` needs to be constructed (which is also why this cannot be `constexpr`);
+compilers fold the result to a constant, so that the storage is never actually allocated. */
+template <typename Base, typename T>
+std::ptrdiff_t base_offset() {
+    if constexpr (!std::is_base_of_v<Base, T>) {
+        return 0;
+    } else {
+        static_assert(IsNonVirtualBaseOf<Base, T>,
+                      "`Base` must be an accessible, unambiguous, non-virtual base of `T`");
+        alignas(T) std::byte storage[sizeof(T)];
+        auto base = static_cast<Base*>(reinterpret_cast<T*>(storage));
+        return reinterpret_cast<std::byte*>(base) - storage;
+    }
+}
+
+/* Returns the offset of the `Base` subobject within the type with tag `tag` in a
+`TaggedPointer<Ts...>` (and 0 for the null tag, and for types not derived from `Base`). This is
+written as a chain of comparisons of `tag` with constants, which compilers turn into a switch,
+and then into a lookup in a constant table (or a bit test); unlike a function-local static table,
+this needs no guard variable checked on every call, and no initialization at all. */
+template <typename Base, typename... Ts>
+std::ptrdiff_t base_offset_of_tag(unsigned tag) {
+    return [tag]<std::size_t... Is>(std::index_sequence<Is...>) {
+        std::ptrdiff_t offset = 0;
+        (void)(... || (tag == Is + 1 && (offset = base_offset<Base, Ts>(), true)));
+        return offset;
+    }(std::index_sequence_for<Ts...>{});
+}
+
+/* Returns the name of the type `T`, extracted at compile-time from the signature of this function
+as given by `__PRETTY_FUNCTION__` (GCC/Clang) or `__FUNCSIG__` (MSVC). */
+template <typename T>
+constexpr std::string_view type_name() {
+#if defined(__GNUC__) || defined(__clang__)
+    /* For instance, "std::string_view detail::type_name() [with T = Circle; ...]" on GCC, and
+    "std::string_view detail::type_name() [T = Circle]" on Clang. */
+    std::string_view signature = __PRETTY_FUNCTION__;
+    auto begin = signature.find("T = ") + 4;
+    return signature.substr(begin, signature.find_first_of(";]", begin) - begin);
+#elif defined(_MSC_VER)
+    /* For instance,
+    "class std::basic_string_view<...> __cdecl detail::type_name<struct Circle>(void)". */
+    std::string_view signature = __FUNCSIG__;
+    auto begin = signature.find("type_name<") + 10;
+    return signature.substr(begin, signature.rfind(">(void)") - begin);
+#else
+    return "unknown";
+#endif
+}
+
+/* `type_info_table<Ts...>[tag]` is the `TaggedTypeInfo` of the type with tag `tag` in a
+`TaggedPointer<Ts...>`. The entry for the null tag describes `std::nullptr_t`, with a size and
+alignment of 0. */
+template <typename... Ts>
+constexpr std::array<TaggedTypeInfo, sizeof...(Ts) + 1> type_info_table = {
+    TaggedTypeInfo{0, 0, "std::nullptr_t", true, true},
+    TaggedTypeInfo{sizeof(Ts), alignof(Ts), type_name<Ts>(),
+                   std::is_trivially_destructible_v<Ts>, std::is_trivially_copyable_v<Ts>}...
+};
+
+/* `TypeTraitTable<Trait, Ts...>::table[tag]` is `Trait<T>::value`, where `T` is the type with tag
+`tag` in a `TaggedPointer<Ts...>`. The entry for the null tag is value-initialized. */
+template <template <typename> typename Trait, typename... Ts>
+struct TypeTraitTable {
+    using Value = std::common_type_t<std::remove_cvref_t<decltype(Trait<Ts>::value)>...>;
+    constexpr static std::array<Value, sizeof...(Ts) + 1> table = {Value{}, Trait<Ts>::value...};
+};
+
+/* Calls `func(ptr)` and returns the result, or returns `std::monostate` if `func` returns `void`,
+so that the result can always be stored (in a `std::tuple`, for `call_all`). */
+template <typename Func, typename T>
+auto result_or_monostate(Func &func, T *ptr) {
+    if constexpr (std::is_void_v<decltype(func(ptr))>) {
+        func(ptr);
+        return std::monostate{};
+    } else {
+        return func(ptr);
+    }
+}
+
+/* `BoundCall<Func, Args...>`, when called with a pointer `ptr`, calls `func(ptr, args...)`, with
+`args...` perfectly forwarded. Both `func` and `args...` are held by reference, so a `BoundCall` is
+just a few pointers, and is optimized away entirely once `dispatch_call` is inlined. Must only be
+called once, as rvalue arguments are moved from. */
+template <typename Func, typename... Args>
+struct BoundCall {
+    Func &func;
+    std::tuple<Args&&...> args;
+
+    template <typename T>
+    decltype(auto) operator()(T *ptr) {
+        return std::apply([&](Args &&...unpacked) -> decltype(auto) {
+            return func(ptr, std::forward<Args>(unpacked)...);
+        }, std::move(args));
+    }
+};
+
+/* `UniqueVariant<std::variant<Vs...>, Rs...>::type` is `std::variant<Vs..., Rs...>` with duplicate
+types removed (keeping the first occurrence of each), so that each alternative can be constructed
+unambiguously. */
+template <typename Variant, typename... Rs>
+struct UniqueVariant {using type = Variant;};
+
+template <typename... Vs, typename R, typename... Rs>
+struct UniqueVariant<std::variant<Vs...>, R, Rs...>
+    : std::conditional_t<(std::is_same_v<R, Vs> || ...),
+                         UniqueVariant<std::variant<Vs...>, Rs...>,
+                         UniqueVariant<std::variant<Vs..., R>, Rs...>> {};
+
+/* `MonostateIfVoid_t<R>` is `std::monostate` if `R` is `void`, and `R` without references and
+cv-qualifiers otherwise. */
+template <typename R>
+using MonostateIfVoid_t = std::conditional_t<std::is_void_v<R>, std::monostate,
+                                             std::remove_cvref_t<R>>;
+
+/* `UnifiedResult<Rs...>` combines the return types `Rs...` of the arms of a dispatch into the
+return type of the dispatch:
+- If all of `Rs...` are the same (up to references and cv-qualifiers, which `dispatch_call` drops
+  anyway), `all_same` is `true`, and no conversion is needed.
+- Otherwise, if `std::common_type_t<Rs...>` exists, the result is converted to it.
+- Otherwise, the result is stored in a `std::variant` of the distinct types in `Rs...`, where
+  `void` becomes `std::monostate`. */
+template <typename... Rs>
+struct UnifiedResult {
+    using First = std::tuple_element_t<0, std::tuple<Rs...>>;
+    constexpr static bool all_same
+        = (std::is_same_v<std::remove_cvref_t<Rs>, std::remove_cvref_t<First>> && ...);
+    constexpr static bool is_variant = !all_same && !requires {typename std::common_type_t<Rs...>;};
+
+    using type = typename std::conditional_t<
+        is_variant, UniqueVariant<std::variant<>, MonostateIfVoid_t<Rs>...>,
+        std::common_type<Rs...>>::type;
+};
+
+/* `ConvertResult<Result, IsVariant, Func>`, when called with a pointer `ptr`, calls `func(ptr)` and
+converts the returned value to `Result`, which is a `std::variant` iff `IsVariant` is `true`. */
+template <typename Result, bool IsVariant, typename Func>
+struct ConvertResult {
+    Func &func;
+
+    template <typename T>
+    Result operator()(T *ptr) {
+        using R = decltype(func(ptr));
+        if constexpr (IsVariant && std::is_void_v<R>) {
+            func(ptr);
+            return Result{std::in_place_type<std::monostate>};
+        } else if constexpr (IsVariant) {
+            return Result{std::in_place_type<std::remove_cvref_t<R>>, func(ptr)};
+        } else {
+            return static_cast<Result>(func(ptr));
+        }
+    }
+};
+
+/* `CopyConst_t<VoidPtr, T>` is `const T` if `VoidPtr` is `const void*`, and `T` otherwise. */
+template <typename VoidPtr, typename T>
+using CopyConst_t = std::conditional_t<std::is_const_v<std::remove_pointer_t<VoidPtr>>, const T, T>;
+
+/* Calls `dispatch_call<Func, Ts...>(func, ptr, type_index)`, except that the arms of the dispatch
+may return different types, which are combined as described for `UnifiedResult`. When every arm
+returns the same type, `func` is passed to `dispatch_call` as-is. */
+template <typename Func, typename... Ts, typename VoidPtr>
+decltype(auto) dispatch_call_unified(Func &&func, VoidPtr ptr, unsigned type_index) {
+#ifdef TAGGED_POINTER_INSTRUMENT
+    DispatchProbe probe(dispatch_site<std::remove_cvref_t<Func>, Ts...>(), type_index);
+#endif
+    using Unified = UnifiedResult<decltype(func(static_cast<CopyConst_t<VoidPtr, Ts>*>(ptr)))...>;
+    if constexpr (Unified::all_same) {
+        return dispatch_call<Func, Ts...>(std::forward<Func>(func), ptr, type_index);
+    } else {
+        using Convert = ConvertResult<typename Unified::type, Unified::is_variant,
+                                      std::remove_reference_t<Func>>;
+        return dispatch_call<Convert, Ts...>(Convert{func}, ptr, type_index);
+    }
+}
+
+/* `UnifiedResultOf<Func, VoidPtr, Ts...>` is the `UnifiedResult` of the arms of a dispatch of
+`func` over `Ts...`, given a `VoidPtr`, and `UnifiedReturn_t<Func, VoidPtr, Ts...>` is the type
+`dispatch_call_unified<Func, Ts...>` then returns. */
+template <typename Func, typename VoidPtr, typename... Ts>
+using UnifiedResultOf = UnifiedResult<
+    decltype(std::declval<Func&>()(static_cast<CopyConst_t<VoidPtr, Ts>*>(nullptr)))...>;
+
+template <typename Func, typename VoidPtr, typename... Ts>
+using UnifiedReturn_t = typename std::conditional_t<
+    UnifiedResultOf<Func, VoidPtr, Ts...>::all_same,
+    std::remove_cvref<typename UnifiedResultOf<Func, VoidPtr, Ts...>::First>,
+    UnifiedResultOf<Func, VoidPtr, Ts...>>::type;
+
+/* Calls `func(ptr)` for a single arm of a dispatch over `Ts...`, converting the result to the
+type the whole dispatch returns, `UnifiedReturn_t<Func, VoidPtr, Ts...>`. */
+template <typename VoidPtr, typename... Ts, typename Func, typename T>
+UnifiedReturn_t<Func, VoidPtr, Ts...> call_unified_arm(Func &func, T *ptr) {
+    using Unified = UnifiedResultOf<Func, VoidPtr, Ts...>;
+    if constexpr (Unified::all_same) {
+        return func(ptr);
+    } else {
+        return ConvertResult<typename Unified::type, Unified::is_variant, Func>{func}(ptr);
+    }
+}
+
+/* The out-of-line, full dispatch of `dispatch_call_hot`, for the types not declared hot. It is
+marked cold so that the compiler places it away from the hot path, and never inlines it. */
+template <typename... Ts, typename Func, typename VoidPtr>
+[[gnu::cold]] [[gnu::noinline]]
+UnifiedReturn_t<Func, VoidPtr, Ts...> dispatch_call_cold(Func &func, VoidPtr ptr,
+                                                         unsigned type_index) {
+    return dispatch_call_unified<Func&, Ts...>(func, ptr, type_index);
+}
+
+/* Calls `func`, passing to it `ptr` casted to the `type_index`th type of `Ts...`, like
+`dispatch_call_unified`, but first compares `type_index` with the index of each hot type `H, Hs...`
+in turn, and only calls `dispatch_call_cold` if none matches. */
+template <typename H, typename... Hs, typename... Ts, typename Func, typename VoidPtr>
+UnifiedReturn_t<Func, VoidPtr, Ts...> dispatch_call_hot(hot<H, Hs...>, TypeCategory<Ts...>,
+                                                        Func &func, VoidPtr ptr,
+                                                        unsigned type_index) {
+    if (type_index == IndexOfType_v<H, Ts...>) [[likely]] {
+#ifdef TAGGED_POINTER_INSTRUMENT
+        /* The other types are counted by `dispatch_call_unified`, from `dispatch_call_cold`. */
+        DispatchProbe probe(dispatch_site<std::remove_cvref_t<Func>, Ts...>(), type_index);
+#endif
+        return call_unified_arm<VoidPtr, Ts...>(func, static_cast<CopyConst_t<VoidPtr, H>*>(ptr));
+    }
+    if constexpr (sizeof...(Hs) > 0) {
+        return dispatch_call_hot(hot<Hs...>{}, TypeCategory<Ts...>{}, func, ptr, type_index);
+    } else {
+        return dispatch_call_cold<Ts...>(func, ptr, type_index);
+    }
+}
+
 };  /* Ending bracket for `namespace detail` */
 
 /* `TaggedPointer<Ts...>` represents a type-tagged pointer to one of the set of types specified by
@@ -60,12 +384,22 @@ class TaggedPointer {
     while the remaining bits are the tag. */
     uintptr_t tagged_address;
 
+    /* Wrappers such as `TaggedOptional` and the bulk algorithms need to read and write
+    `tagged_address` directly; they do so through `detail::TaggedPointerAccess`. */
+    friend struct detail::TaggedPointerAccess;
+
 public:
 
     /* Returns the number of types this `TaggedPointer` can point to; that is, the size of
     the given parameter pack `Ts...`. */
     static constexpr auto num_types() {return sizeof...(Ts);}
 
+    /* Returns the largest tag that fits in the `64 - TAG_SHIFT` tag bits of `tagged_address`.
+    Only the tags in `[0, num_types()]` are ever used by a `TaggedPointer` itself; the tags in
+    `(num_types(), max_tag()]` are unused, and so wrappers are free to use them to encode extra
+    states (see "tagged_optional.h"). */
+    static constexpr unsigned max_tag() {return static_cast<unsigned>(~uintptr_t{0} >> TAG_SHIFT);}
+
     /* Returns the tag of the type `T` in this `TaggedPointer<Ts...>`. The tag of a type `T`
     is determined as follows:
     - If `T` is `std::nullptr_t` (that is, if this `TaggedPointer` was constructed or set
@@ -87,6 +421,19 @@ public:
 
     /* Returns the current tag of this `TaggedPointer`. */
     auto tag() const {return static_cast<unsigned>(tagged_address >> TAG_SHIFT);}
+
+    /* Returns the `TaggedTypeInfo` (size, alignment, name, and whether it is trivially
+    destructible and copyable) of the type currently pointed to by this `TaggedPointer`. This is a
+    single load from a table indexed by `tag()`, with no dispatch. */
+    const TaggedTypeInfo &type_info() const {return detail::type_info_table<Ts...>[tag()];}
+
+    /* Returns `Trait<T>::value`, where `T` is the type currently pointed to by this
+    `TaggedPointer`, and `Trait` is any class template with a `constexpr static` member `value`
+    (such as `std::is_polymorphic`, or a user-defined trait). Like `type_info`, this is a single
+    load from a table indexed by `tag()`. For a tagged null pointer, returns a value-initialized
+    value. */
+    template <template <typename> typename Trait>
+    auto type_trait() const {return detail::TypeTraitTable<Trait, Ts...>::table[tag()];}
     
     /* Returns the address of the pointer stored in this `TaggedPointer` as a `void*`. */
     const void *ptr() const {return reinterpret_cast<const void*>(tagged_address & GET_PTR_MASK);}
@@ -166,10 +513,84 @@ public:
         return tag() == get_tag_of_type<T>();
     }
 
+    /* Returns the bitmask whose `i`th bit is set iff `i` is the tag of one of the types `Us...`
+    (where each of `Us...` is one of `Ts...`, or a `TypeCategory` of them). As there are at most
+    `max_tag() + 1 = 32` tags, every set of types has such a mask, no matter which tags the types
+    were assigned. */
+    template <typename... Us>
+    static constexpr uintptr_t get_tag_mask_of_types() {
+        return get_tag_mask_of_category(detail::FlattenCategories_t<Us...>{});
+    }
+
+    /* Returns `true` iff this `TaggedPointer` currently points to any of the types `Us...`, where
+    each of `Us...` is one of `Ts...`, or a `TypeCategory` of them. */
+    template <typename... Us>
+    bool points_to_any() const {
+        /* Rather than comparing `tag()` against the tag of every type in `Us...`, we look up bit
+        `tag()` of the tag mask of `Us...`; a single shift-and-mask, regardless of the number of
+        types. */
+        return (get_tag_mask_of_types<Us...>() >> tag()) & 1;
+    }
+
+    /* If this `TaggedPointer` currently points to one of the types `Us...` (where each of `Us...`
+    is one of `Ts...`, or a `TypeCategory` of them), calls `func` exactly as `call` does, except
+    that the dispatch is over `Us...` only; in particular, if `func` returns different types for
+    different types in `Us...`, the results are combined as described for `call`. If `func`
+    returns `void`, returns whether `func` was called; otherwise, returns the result of `func`
+    wrapped in a `std::optional`, which is empty iff `func` was not called. */
+    template <typename... Us, typename Func>
+    auto call_if(Func &&func) {
+        return call_if_category<false>(detail::FlattenCategories_t<Us...>{},
+                                       std::forward<Func>(func), ptr());
+    }
+
+    /* See the non-const overload of `call_if`. */
+    template <typename... Us, typename Func>
+    auto call_if(Func &&func) const {
+        return call_if_category<true>(detail::FlattenCategories_t<Us...>{},
+                                      std::forward<Func>(func), ptr());
+    }
+
+    /* Returns `true` iff this `TaggedPointer` currently points to a type derived from `Base` (or
+    to `Base` itself, if `Base` is one of `Ts...`). Like `points_to_any`, this is a single lookup
+    in a compile-time tag mask, regardless of how many of `Ts...` derive from `Base`. */
+    template <typename Base>
+    requires (std::is_base_of_v<Base, Ts> || ...)
+    bool isa() const {
+        constexpr uintptr_t mask = ((std::is_base_of_v<Base, Ts>
+                                     ? static_cast<uintptr_t>(1) << get_tag_of_type<Ts>() : 0) | ...);
+        return (mask >> tag()) & 1;
+    }
+
+    /* Returns the stored pointer upcast to a `Base*` if this `TaggedPointer` currently points to a
+    type derived from `Base`, and `nullptr` otherwise. Rather than dispatching on the current
+    type, the upcast adds the offset of the `Base` subobject, which is looked up by `tag()` in
+    a constant table (see `detail::base_offset_of_tag`). `Base` must be a non-virtual base class
+    of every type in `Ts...` derived from it. */
+    template <typename Base>
+    requires (std::is_base_of_v<Base, Ts> || ...)
+    Base *dyn_cast() {
+        auto address = static_cast<std::byte*>(ptr())
+                     + detail::base_offset_of_tag<Base, Ts...>(tag());
+        return isa<Base>() ? static_cast<Base*>(static_cast<void*>(address)) : nullptr;
+    }
+
+    /* Returns the stored pointer upcast to a `const Base*` if this `TaggedPointer` currently
+    points to a type derived from `Base`, and `nullptr` otherwise. See the non-const overload. */
+    template <typename Base>
+    requires (std::is_base_of_v<Base, Ts> || ...)
+    const Base *dyn_cast() const {
+        auto address = static_cast<const std::byte*>(ptr())
+                     + detail::base_offset_of_tag<Base, Ts...>(tag());
+        return isa<Base>() ? static_cast<const Base*>(static_cast<const void*>(address)) : nullptr;
+    }
+
     /* Calls the function `func`, passing to it the pointer stored in this `TaggedPointer`,
     casted to the correct type, and returns the resulting value (with value category/cv-qualifiers
-    preserved). `func` must have a single return type across all possible types pointed to by this
-    `TaggedPointer`; if not, a compiler error will be raised. */
+    preserved). If `func` returns different types for different types pointed to by this
+    `TaggedPointer`, the results are converted to their `std::common_type_t` if there is one, and
+    are otherwise returned in a `std::variant` of the distinct return types (with `void` replaced by
+    `std::monostate`); see `detail::UnifiedResult`. */
     template <typename Func>
     /* We use `decltype(auto)` as the return type. This is a C++14 feature that enables perfect
     forwarding of the return type; that is, it ensures that reference types are returned as
@@ -188,7 +609,8 @@ public:
     depending on the specific type/value category/cv-q qualifiers of the expression it returns. */
     decltype(auto) call(Func &&func) {
         /* The work of casting the underlying pointer to its correct type and passing the casted
-        pointer to `func` is all done by `dispatch_call`.
+        pointer to `func` is all done by `dispatch_call` (through `dispatch_call_unified`, which
+        only intervenes if the return types of `func` differ).
         
         Note that the `std::forward` is necessary for the `func` parameter below. If this was
         omitted, then trying to pass in a lambda directly to `call`, such as in
@@ -207,19 +629,109 @@ public:
         it was passed in as a rvalue, and if `func` was passed in as a lvalue, it remains a lvalue.
         This makes a type mismatch between the `func` parameter of `dispatch_call<Func, Ts...>`
         and the `func` parameter of `call` impossible, resolving the issue. */
-        return detail::dispatch_call<Func, Ts...>(std::forward<Func>(func), ptr(), tag() - 1);
+        return detail::dispatch_call_unified<Func, Ts...>(std::forward<Func>(func), ptr(),
+                                                          tag() - 1);
     }
 
     /* Calls the function `func`, passing to it the pointer stored in this `TaggedPointer`,
     casted to the correct type, and returns the resulting value (with value category/cv-qualifiers
-    preserved). `func` must have a single return type across all possible types pointed to by this
-    `TaggedPointer`; if not, a compiler error will be raised. */
+    preserved). See the non-const overload for how differing return types are handled. */
     template <typename Func>
     /* See the non-const overload of `call` for why the return type needs to be `decltype(auto)`. */
     decltype(auto) call(Func &&func) const {
         /* See the comment here in the non-const overload of `call`; these two functions are
         identical. */
-        return detail::dispatch_call<Func, Ts...>(std::forward<Func>(func), ptr(), tag() - 1);
+        return detail::dispatch_call_unified<Func, Ts...>(std::forward<Func>(func), ptr(),
+                                                          tag() - 1);
+    }
+
+    /* Calls `func(typed_ptr, args...)`, where `typed_ptr` is the pointer stored in this
+    `TaggedPointer`, casted to the correct type, and returns the resulting value; `args...` are
+    perfectly forwarded. This lets `func` be a stateless function object shared by every call site,
+    instead of a lambda capturing the arguments. Without extra arguments, the overload above is
+    used, so existing calls are unaffected. */
+    template <typename Func, typename... Args>
+    requires (sizeof...(Args) > 0)
+    decltype(auto) call(Func &&func, Args &&...args) {
+        using Bound = detail::BoundCall<Func, Args...>;
+        return detail::dispatch_call_unified<Bound, Ts...>(
+            Bound{func, {std::forward<Args>(args)...}}, ptr(), tag() - 1);
+    }
+
+    /* Calls `func(typed_ptr, args...)`, where `typed_ptr` is the pointer stored in this
+    `TaggedPointer`, casted to the correct type. See the non-const overload. */
+    template <typename Func, typename... Args>
+    requires (sizeof...(Args) > 0)
+    decltype(auto) call(Func &&func, Args &&...args) const {
+        using Bound = detail::BoundCall<Func, Args...>;
+        return detail::dispatch_call_unified<Bound, Ts...>(
+            Bound{func, {std::forward<Args>(args)...}}, ptr(), tag() - 1);
+    }
+
+    /* Calls `func` exactly as `call` does, but optimized for the case where this `TaggedPointer`
+    usually points to one of the hot types `Hs...` (see `hot`): the tags of `Hs...` are tested
+    first, in order, and the dispatch over all other types happens in a separate function marked
+    `[[gnu::cold]]`, keeping the hot path short. Only worthwhile at about 95% skew or more. */
+    template <typename... Hs, typename Func>
+    requires (sizeof...(Hs) > 0) && (detail::ContainsType<Hs, Ts...> && ...)
+    decltype(auto) call(hot<Hs...>, Func &&func) {
+        return detail::dispatch_call_hot(hot<Hs...>{}, TypeCategory<Ts...>{}, func, ptr(),
+                                         tag() - 1);
+    }
+
+    /* Calls `func` exactly as `call` does, testing the hot types `Hs...` first. See the non-const
+    overload. */
+    template <typename... Hs, typename Func>
+    requires (sizeof...(Hs) > 0) && (detail::ContainsType<Hs, Ts...> && ...)
+    decltype(auto) call(hot<Hs...>, Func &&func) const {
+        return detail::dispatch_call_hot(hot<Hs...>{}, TypeCategory<Ts...>{}, func, ptr(),
+                                         tag() - 1);
+    }
+
+    /* Calls `func` exactly as `call` does if this `TaggedPointer` is non-null, and otherwise calls
+    `fallback` with no arguments. Both must return the same type. Note that `call` itself must not
+    be used on a tagged null pointer, as `tag() - 1` then wraps around and `dispatch_call` falls
+    through to its `default:` case (the last type in `Ts...`); use `call_or` instead whenever the
+    pointer may be null, or `NonNullTaggedPointer` (see "non_null_tagged_pointer.h") when it
+    never is. */
+    template <typename Func, typename Fallback>
+    decltype(auto) call_or(Func &&func, Fallback &&fallback) {
+        if (tag() == 0) {return std::forward<Fallback>(fallback)();}
+        return call(std::forward<Func>(func));
+    }
+
+    /* Calls `func` exactly as `call` does if this `TaggedPointer` is non-null, and otherwise calls
+    `fallback` with no arguments. See the non-const overload of `call_or`. */
+    template <typename Func, typename Fallback>
+    decltype(auto) call_or(Func &&func, Fallback &&fallback) const {
+        if (tag() == 0) {return std::forward<Fallback>(fallback)();}
+        return call(std::forward<Func>(func));
+    }
+
+    /* Calls each of `funcs...` in order, passing to each the pointer stored in this
+    `TaggedPointer`, casted to the correct type, and returns a `std::tuple` of the results, in
+    which `void` results are replaced by `std::monostate`. Unlike calling `call` once per function,
+    the tag is only decoded and dispatched on once. As with `call`, each function must have a
+    single return type across all types pointed to, and results are returned by value. */
+    template <typename... Funcs>
+    auto call_all(Funcs &&...funcs) {
+        /* The braced initializer guarantees that `funcs...` are called from left to right. */
+        return call([&](auto *ptr) {
+            return std::tuple<decltype(detail::result_or_monostate(funcs, ptr))...>{
+                detail::result_or_monostate(funcs, ptr)...
+            };
+        });
+    }
+
+    /* Calls each of `funcs...` in order on the pointer stored in this `TaggedPointer`, and returns
+    a `std::tuple` of the results. See the non-const overload of `call_all`. */
+    template <typename... Funcs>
+    auto call_all(Funcs &&...funcs) const {
+        return call([&](auto *ptr) {
+            return std::tuple<decltype(detail::result_or_monostate(funcs, ptr))...>{
+                detail::result_or_monostate(funcs, ptr)...
+            };
+        });
     }
 
     /* Two `TaggedPointer<Ts...>` are equal iff both their underlying pointer addresses and their
@@ -272,4 +784,101 @@ public:
 
     /* The default constructor for `TaggedPointer` constructs a tagged null pointer. */
     TaggedPointer() : TaggedPointer(nullptr) {}
-};
\ No newline at end of file
+
+private:
+
+    /* Returns the tag mask (see `get_tag_mask_of_types`) of the flattened category `Us...`. */
+    template <typename... Us>
+    static constexpr uintptr_t get_tag_mask_of_category(TypeCategory<Us...>) {
+        return ((static_cast<uintptr_t>(1) << get_tag_of_type<Us>()) | ... | 0);
+    }
+
+    /* Implements `call_if` for the flattened category `Us...`. `ptr` is `ptr()`, which is a
+    `const void*` iff `IsConst`. */
+    template <bool IsConst, typename... Us, typename Func, typename VoidPtr>
+    auto call_if_category(TypeCategory<Us...>, Func &&func, VoidPtr ptr) const {
+        static_assert(sizeof...(Us) > 0, "`call_if` needs at least one type");
+
+        using First = std::tuple_element_t<0, std::tuple<Us...>>;
+        using Result = detail::UnifiedReturn_t<Func, VoidPtr, Us...>;
+
+        /* `dispatch_call_unified` expects the zero-indexed position of the current type within `Us...`.
+        If the tags of `Us...` are consecutive and increasing, this is `tag()` minus the tag of
+        the first type; otherwise, we look it up in a table indexed by `tag()`. */
+        constexpr unsigned first_tag = get_tag_of_type<First>();
+        constexpr bool consecutive = []<std::size_t... Is>(std::index_sequence<Is...>) {
+            return ((get_tag_of_type<Us>() == first_tag + Is) && ...);
+        }(std::index_sequence_for<Us...>{});
+        constexpr static std::array<unsigned char, max_tag() + 1> positions = [] {
+            std::array<unsigned char, max_tag() + 1> table{};
+            ((table[get_tag_of_type<Us>()] = detail::IndexOfType_v<Us, Us...>), ...);
+            return table;
+        }();
+
+        auto dispatch = [&] {
+            auto position = consecutive ? tag() - first_tag : positions[tag()];
+            return detail::dispatch_call_unified<Func, Us...>(std::forward<Func>(func), ptr,
+                                                              position);
+        };
+
+        if constexpr (std::is_void_v<Result>) {
+            if (!points_to_any<Us...>()) {return false;}
+            dispatch();
+            return true;
+        } else {
+            if (!points_to_any<Us...>()) {return std::optional<Result>{};}
+            return std::optional<Result>{dispatch()};
+        }
+    }
+};
+
+namespace detail {
+
+/* `as_tagged_pointer` is never defined; it is only used in unevaluated contexts to find the
+`TaggedPointer<Ts...>` base of a type (such as `Shape` in example.cpp, which inherits from
+`TaggedPointer<Circle, RightTriangle, Rectangle>`). */
+template <typename... Ts>
+TaggedPointer<Ts...> &as_tagged_pointer(TaggedPointer<Ts...> &);
+
+/* `TaggedPointerLike<TP>` is satisfied iff `TP` is a `TaggedPointer<Ts...>` for some `Ts...`, or
+a type that publicly inherits from one. */
+template <typename TP>
+concept TaggedPointerLike = requires (TP &tp) {detail::as_tagged_pointer(tp);};
+
+/* `TaggedPointerBase_t<TP>` is the `TaggedPointer<Ts...>` that `TP` is, or inherits from. */
+template <typename TP>
+using TaggedPointerBase_t = std::remove_reference_t<decltype(detail::as_tagged_pointer(
+    std::declval<TP&>()))>;
+
+/* `TaggedPointerAccess` exposes the raw `tagged_address` of a `TaggedPointer`, along with its
+layout constants, to the rest of this library. It is not meant to be used by client code, as
+writing arbitrary bits into a `TaggedPointer` breaks its type safety. */
+struct TaggedPointerAccess {
+    /* Returns the `TAG_SHIFT` of the `TaggedPointer` `TP` (or that `TP` inherits from). */
+    template <typename TP>
+    static constexpr unsigned tag_shift() {return TaggedPointerBase_t<TP>::TAG_SHIFT;}
+
+    /* Returns the `GET_PTR_MASK` of the `TaggedPointer` `TP` (or that `TP` inherits from). */
+    template <typename TP>
+    static constexpr uintptr_t ptr_mask() {return TaggedPointerBase_t<TP>::GET_PTR_MASK;}
+
+    /* Returns the `tagged_address` of `tp`. */
+    template <typename... Ts>
+    static uintptr_t bits(const TaggedPointer<Ts...> &tp) {return tp.tagged_address;}
+
+    /* Sets the `tagged_address` of `tp` to `tagged_address`. */
+    template <typename... Ts>
+    static void set_bits(TaggedPointer<Ts...> &tp, uintptr_t tagged_address) {
+        tp.tagged_address = tagged_address;
+    }
+
+    /* Returns a `TP` whose `tagged_address` equals `tagged_address`. */
+    template <typename TP>
+    static TP from_bits(uintptr_t tagged_address) {
+        TP tp;
+        set_bits(tp, tagged_address);
+        return tp;
+    }
+};
+
+};  /* Ending bracket for `namespace detail` */
@@ -0,0 +1,872 @@
+/* Implements bulk operations over arrays of `TaggedPointer`s. Every `TaggedPointer` stores its tag
+in the bits starting from bit `TAG_SHIFT` of a single `uintptr_t`, so an array of `TaggedPointer`s
+is simply an array of `uintptr_t`s, and bulk operations can process many of them at once using
+SIMD instructions. Each operation is implemented by a scalar kernel, plus SSE4.2, AVX2 and
+AVX-512 kernels on x86 with GCC or Clang.
+
+Every SIMD kernel is compiled for its own instruction set with `__attribute__((target(...)))`,
+regardless of the flags the rest of the program is compiled with, and the kernel used at runtime
+is picked once, at first use, from what the CPU supports (as reported by `cpuid`). Thus a single
+binary runs the AVX-512 kernels on AVX-512 hosts, and the AVX2 kernels on AVX2-only hosts. The
+choice can be lowered by setting the environment variable `TAGGED_POINTER_ISA` to one of
+`scalar`, `sse4.2`, `avx2` or `avx512`, or at runtime with `set_bulk_isa`; `for_each_bulk_isa`
+runs a function once under every supported instruction set, for benchmarking the kernels against
+each other on the same data.
+
+The kernels themselves (in `namespace detail`) operate on raw `uintptr_t` words; the public
+functions accept `std::span`s of `TaggedPointer`s (or of types inheriting from `TaggedPointer`,
+such as `Shape` in example.cpp). As the element type of the `std::span` cannot be deduced from a
+container, pass it explicitly, as in `tag_histogram<Shape>(my_shapes)`. */
+
+#pragma once
+
+#include <algorithm>        // For `std::copy`
+#include <array>            // For `std::array`
+#include <atomic>           // For `std::atomic`
+#include <cassert>          // For `assert`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`, `uint8_t`
+#include <cstdlib>          // For `std::getenv`
+#include <span>             // For `std::span`
+#include <string_view>      // For `std::string_view`
+#include <type_traits>      // For `std::is_standard_layout_v`
+#include <utility>          // For `std::swap`
+#include <vector>           // For `std::vector`
+#include "tagged_pointer.h"
+
+/* `TAGGED_POINTER_BULK_X86` is 1 iff the SIMD kernels are available; they need x86 intrinsics, and
+GCC/Clang's `target` attribute and `__builtin_cpu_supports`. */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TAGGED_POINTER_BULK_X86 1
+#include <immintrin.h>
+#define TAGGED_POINTER_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define TAGGED_POINTER_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TAGGED_POINTER_TARGET_AVX512 __attribute__((target("avx512f,avx2,popcnt")))
+#else
+#define TAGGED_POINTER_BULK_X86 0
+#endif
+
+/* `BulkIsa` lists the instruction sets the bulk kernels are implemented for, from narrowest to
+widest. */
+enum class BulkIsa {Scalar, SSE42, AVX2, AVX512};
+
+/* Returns the name of `isa`, as accepted by the `TAGGED_POINTER_ISA` environment variable. */
+inline const char *bulk_isa_name(BulkIsa isa) {
+    switch (isa) {
+        case BulkIsa::Scalar: return "scalar";
+        case BulkIsa::SSE42: return "sse4.2";
+        case BulkIsa::AVX2: return "avx2";
+        default: return "avx512";
+    }
+}
+
+namespace detail {
+
+/* `ALL_BULK_ISAS` lists every `BulkIsa`, from narrowest to widest. */
+constexpr std::array<BulkIsa, 4> ALL_BULK_ISAS = {
+    BulkIsa::Scalar, BulkIsa::SSE42, BulkIsa::AVX2, BulkIsa::AVX512
+};
+
+/* Returns the widest `BulkIsa` supported by this CPU. Computed once. */
+inline BulkIsa widest_supported_bulk_isa() {
+    static const BulkIsa widest = [] {
+#if TAGGED_POINTER_BULK_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2")) {
+            return BulkIsa::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return BulkIsa::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+            return BulkIsa::SSE42;
+        }
+#endif
+        return BulkIsa::Scalar;
+    }();
+    return widest;
+}
+
+/* Returns the `BulkIsa` whose kernels are currently used. Initialized to the widest supported
+`BulkIsa`, or to the one named by the `TAGGED_POINTER_ISA` environment variable if that is
+narrower. Unknown names are ignored. */
+inline std::atomic<BulkIsa> &active_bulk_isa_state() {
+    static std::atomic<BulkIsa> active = [] {
+        auto isa = widest_supported_bulk_isa();
+        if (const char *requested = std::getenv("TAGGED_POINTER_ISA")) {
+            for (auto candidate : ALL_BULK_ISAS) {
+                if (std::string_view{requested} == bulk_isa_name(candidate) && candidate < isa) {
+                    isa = candidate;
+                }
+            }
+        }
+        return isa;
+    }();
+    return active;
+}
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Returns the `BulkIsa` whose kernels are currently used by the bulk operations. */
+inline BulkIsa active_bulk_isa() {
+    return detail::active_bulk_isa_state().load(std::memory_order_relaxed);
+}
+
+/* Makes the bulk operations use the kernels for `isa` from now on, in every thread. Returns
+`false`, and changes nothing, if this CPU does not support `isa`. */
+inline bool set_bulk_isa(BulkIsa isa) {
+    if (isa > detail::widest_supported_bulk_isa()) {return false;}
+    detail::active_bulk_isa_state().store(isa, std::memory_order_relaxed);
+    return true;
+}
+
+/* Returns every `BulkIsa` this CPU supports, from narrowest to widest. */
+inline std::vector<BulkIsa> supported_bulk_isas() {
+    std::vector<BulkIsa> result;
+    for (auto isa : detail::ALL_BULK_ISAS) {
+        if (isa <= detail::widest_supported_bulk_isa()) {result.push_back(isa);}
+    }
+    return result;
+}
+
+/* Calls `func(isa)` once for every `BulkIsa` this CPU supports, with the bulk operations using the
+kernels for `isa` during that call, then restores the previously active `BulkIsa`. This is meant
+for benchmarking every kernel on the same data. As `set_bulk_isa` affects every thread, no other
+thread should use the bulk operations meanwhile. */
+template <typename Func>
+void for_each_bulk_isa(Func &&func) {
+    auto previous = active_bulk_isa();
+    for (auto isa : supported_bulk_isas()) {
+        set_bulk_isa(isa);
+        func(isa);
+    }
+    set_bulk_isa(previous);
+}
+
+namespace detail {
+
+/* `TAG_SHIFT` is the same for every `TaggedPointer`, which lets the kernels below be ordinary
+(non-template) functions. */
+constexpr unsigned BULK_TAG_SHIFT = TaggedPointerAccess::tag_shift<TaggedPointer<>>();
+
+/* `NUM_BULK_TAGS` is the number of possible tags, `max_tag() + 1`. */
+constexpr unsigned NUM_BULK_TAGS = TaggedPointer<>::max_tag() + 1;
+
+/* Operations that first extract tags into a buffer on the stack do so `BULK_BLOCK_SIZE` words at a
+time. */
+constexpr std::size_t BULK_BLOCK_SIZE = 1024;
+
+/* Returns the `tagged_address`es of the elements of `tagged_ptrs`, as an array of `uintptr_t`s.
+This is valid because `TP` is standard-layout and consists of nothing but its `tagged_address`. */
+template <typename TP>
+requires TaggedPointerLike<TP>
+const uintptr_t *words_of(std::span<const TP> tagged_ptrs) {
+    static_assert(std::is_standard_layout_v<TP> && sizeof(TP) == sizeof(uintptr_t),
+                  "Bulk operations require `TP` to add no data members to `TaggedPointer`");
+    return reinterpret_cast<const uintptr_t*>(tagged_ptrs.data());
+}
+
+/* Returns the `tagged_address`es of the elements of `tagged_ptrs`, as an array of `uintptr_t`s. */
+template <typename TP>
+requires TaggedPointerLike<TP>
+uintptr_t *words_of(std::span<TP> tagged_ptrs) {
+    static_assert(std::is_standard_layout_v<TP> && sizeof(TP) == sizeof(uintptr_t),
+                  "Bulk operations require `TP` to add no data members to `TaggedPointer`");
+    return reinterpret_cast<uintptr_t*>(tagged_ptrs.data());
+}
+
+/* Stores the tag of `words[i]` into `out[i]`, for all `i` in `[0, n)`. */
+inline void extract_tags_scalar(const uintptr_t *words, std::size_t n, uint8_t *out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<uint8_t>(words[i] >> BULK_TAG_SHIFT);
+    }
+}
+
+#if TAGGED_POINTER_BULK_X86
+/* SSE4.2 version of `extract_tags_scalar`; handles 8 words per iteration, in the same way as the
+AVX2 version below, except with one 128-bit lane per vector. */
+TAGGED_POINTER_TARGET_SSE42
+inline void extract_tags_sse42(const uintptr_t *words, std::size_t n, uint8_t *out) {
+    /* `shuffles[k]` moves the top bytes of the 2 words in the `k`th vector to bytes `2k` and
+    `2k + 1`, zeroing all other bytes. */
+    alignas(16) constexpr static auto shuffles = [] {
+        std::array<std::array<int8_t, 16>, 4> result{};
+        for (int k = 0; k < 4; ++k) {
+            result[k].fill(static_cast<int8_t>(0x80));
+            result[k][2 * k] = 7;
+            result[k][2 * k + 1] = 15;
+        }
+        return result;
+    }();
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i top_bytes = _mm_setzero_si128();
+        for (int k = 0; k < 4; ++k) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i + 2 * k));
+            auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffles[k].data()));
+            top_bytes = _mm_or_si128(top_bytes, _mm_shuffle_epi8(v, shuffle));
+        }
+        auto tags = _mm_and_si128(_mm_srli_epi16(top_bytes, BULK_TAG_SHIFT - 56),
+                                  _mm_set1_epi8(static_cast<char>(0xFF >> (BULK_TAG_SHIFT - 56))));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), tags);
+    }
+    extract_tags_scalar(words + i, n - i, out + i);
+}
+
+/* AVX2 version of `extract_tags_scalar`; handles 16 words per iteration. The tag of each word
+lives in the top byte of the word (byte 7, or byte 15 of each 128-bit lane), above the top
+`TAG_SHIFT - 56` address bits. Each of the four loaded vectors is shuffled so that its four top
+bytes land in four distinct positions of a 128-bit half, such that ORing the shuffled vectors
+together and then ORing the two 128-bit halves yields the 16 top bytes in order. Shifting those
+bytes right by `TAG_SHIFT - 56` then leaves just the tags. */
+TAGGED_POINTER_TARGET_AVX2
+inline void extract_tags_avx2(const uintptr_t *words, std::size_t n, uint8_t *out) {
+    /* `shuffles[k]` moves the top bytes of the 4 words in the `k`th vector to bytes `4k` and
+    `4k + 1` (lower lane) and `4k + 2` and `4k + 3` (upper lane), zeroing all other bytes. */
+    alignas(32) constexpr static auto shuffles = [] {
+        std::array<std::array<int8_t, 32>, 4> result{};
+        for (int k = 0; k < 4; ++k) {
+            result[k].fill(static_cast<int8_t>(0x80));
+            result[k][4 * k] = 7;
+            result[k][4 * k + 1] = 15;
+            result[k][16 + 4 * k + 2] = 7;
+            result[k][16 + 4 * k + 3] = 15;
+        }
+        return result;
+    }();
+
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i combined = _mm256_setzero_si256();
+        for (int k = 0; k < 4; ++k) {
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i + 4 * k));
+            auto shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(shuffles[k].data()));
+            combined = _mm256_or_si256(combined, _mm256_shuffle_epi8(v, shuffle));
+        }
+        auto top_bytes = _mm_or_si128(_mm256_castsi256_si128(combined),
+                                      _mm256_extracti128_si256(combined, 1));
+        /* There is no 8-bit shift, so shift 16-bit words and mask off the bits that crossed
+        over from the neighboring byte. */
+        auto tags = _mm_and_si128(_mm_srli_epi16(top_bytes, BULK_TAG_SHIFT - 56),
+                                  _mm_set1_epi8(static_cast<char>(0xFF >> (BULK_TAG_SHIFT - 56))));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), tags);
+    }
+    extract_tags_scalar(words + i, n - i, out + i);
+}
+#endif
+
+#if TAGGED_POINTER_BULK_X86
+/* AVX-512 version of `extract_tags_scalar`; handles 8 words per iteration by shifting the tags
+down and then truncating every 64-bit lane to a byte with `vpmovqb`. */
+TAGGED_POINTER_TARGET_AVX512
+inline void extract_tags_avx512(const uintptr_t *words, std::size_t n, uint8_t *out) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        /* The zero-masking forms (with every lane enabled) are equivalent to the unmasked ones,
+        but avoid a spurious `-Wmaybe-uninitialized` from some GCC versions' headers. */
+        auto v = _mm512_loadu_si512(words + i);
+        auto shifted = _mm512_maskz_srli_epi64(0xFF, v, BULK_TAG_SHIFT);
+        auto tags = _mm512_maskz_cvtepi64_epi8(0xFF, shifted);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), tags);
+    }
+    extract_tags_scalar(words + i, n - i, out + i);
+}
+#endif
+
+/* Stores the tag of `words[i]` into `out[i]`, for all `i` in `[0, n)`, using the kernel for
+`active_bulk_isa()`. */
+inline void extract_tags(const uintptr_t *words, std::size_t n, uint8_t *out) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512: return extract_tags_avx512(words, n, out);
+        case BulkIsa::AVX2: return extract_tags_avx2(words, n, out);
+        case BulkIsa::SSE42: return extract_tags_sse42(words, n, out);
+#endif
+        default: return extract_tags_scalar(words, n, out);
+    }
+}
+
+/* Adds, to `counts[t]`, the number of bytes equal to `t` in `tags[0, n)`, for all `t` in
+`[0, num_tags)`. Four separate tables of counts are used so that runs of equal tags do not
+serialize on a single counter. */
+inline void count_tags_scalar(const uint8_t *tags, std::size_t n, uint64_t *counts,
+                              unsigned num_tags) {
+    uint64_t partial[4][NUM_BULK_TAGS] = {};
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        ++partial[0][tags[i]];
+        ++partial[1][tags[i + 1]];
+        ++partial[2][tags[i + 2]];
+        ++partial[3][tags[i + 3]];
+    }
+    for (; i < n; ++i) {++partial[0][tags[i]];}
+    for (unsigned t = 0; t < num_tags; ++t) {
+        counts[t] += partial[0][t] + partial[1][t] + partial[2][t] + partial[3][t];
+    }
+}
+
+#if TAGGED_POINTER_BULK_X86
+/* SSE4.2 version of `count_tags_scalar`; see the AVX2 version below. Compares 16 tags at a time. */
+TAGGED_POINTER_TARGET_SSE42
+inline void count_tags_sse42(const uint8_t *tags, std::size_t n, uint64_t *counts,
+                             unsigned num_tags) {
+    if (num_tags > 8) {
+        count_tags_scalar(tags, n, counts, num_tags);
+        return;
+    }
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + i));
+        for (unsigned t = 0; t < num_tags; ++t) {
+            auto matches = _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(t)));
+            counts[t] += static_cast<uint64_t>(
+                __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(matches))));
+        }
+    }
+    count_tags_scalar(tags + i, n - i, counts, num_tags);
+}
+
+/* AVX2 version of `count_tags_scalar`; compares 32 tags at a time against each possible tag, and
+counts the matches with a `popcnt` of the comparison mask. This beats the scalar version as long
+as there are few possible tags, which is the common case. */
+TAGGED_POINTER_TARGET_AVX2
+inline void count_tags_avx2(const uint8_t *tags, std::size_t n, uint64_t *counts,
+                            unsigned num_tags) {
+    if (num_tags > 8) {
+        count_tags_scalar(tags, n, counts, num_tags);
+        return;
+    }
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + i));
+        for (unsigned t = 0; t < num_tags; ++t) {
+            auto matches = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(t)));
+            counts[t] += static_cast<uint64_t>(
+                __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(matches))));
+        }
+    }
+    count_tags_scalar(tags + i, n - i, counts, num_tags);
+}
+#endif
+
+/* Adds, to `counts[t]`, the number of bytes equal to `t` in `tags[0, n)`, for all `t` in
+`[0, num_tags)`, using the kernel for `active_bulk_isa()`. There is no AVX-512 kernel, as the AVX2
+kernel is already limited by the speed of `popcnt`. */
+inline void count_tags(const uint8_t *tags, std::size_t n, uint64_t *counts, unsigned num_tags) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512:
+        case BulkIsa::AVX2: return count_tags_avx2(tags, n, counts, num_tags);
+        case BulkIsa::SSE42: return count_tags_sse42(tags, n, counts, num_tags);
+#endif
+        default: return count_tags_scalar(tags, n, counts, num_tags);
+    }
+}
+
+/* Adds, to `counts[t]`, the number of words in `words[0, n)` with tag `t`, for all `t` in
+`[0, num_tags)`. The tags are extracted into a small buffer one block at a time, and then
+counted. */
+inline void tag_histogram(const uintptr_t *words, std::size_t n, uint64_t *counts,
+                          unsigned num_tags) {
+    uint8_t tags[BULK_BLOCK_SIZE];
+    for (std::size_t i = 0; i < n; i += BULK_BLOCK_SIZE) {
+        auto block_size = n - i < BULK_BLOCK_SIZE ? n - i : BULK_BLOCK_SIZE;
+        extract_tags(words + i, block_size, tags);
+        count_tags(tags, block_size, counts, num_tags);
+    }
+}
+
+/* Stores `addresses[i] | tag_bits` into `out[i]`, for all `i` in `[0, n)`. `tag_bits` is a tag
+already shifted left by `TAG_SHIFT`. */
+inline void tag_words_scalar(const uintptr_t *addresses, std::size_t n, uintptr_t tag_bits,
+                             uintptr_t *out) {
+    for (std::size_t i = 0; i < n; ++i) {out[i] = addresses[i] | tag_bits;}
+}
+
+/* Stores `words[i] & mask` into `out[i]`, for all `i` in `[0, n)`. */
+inline void mask_words_scalar(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                              uintptr_t *out) {
+    for (std::size_t i = 0; i < n; ++i) {out[i] = words[i] & mask;}
+}
+
+#if TAGGED_POINTER_BULK_X86
+/* SSE4.2 version of `tag_words_scalar`; handles 4 words per iteration. */
+TAGGED_POINTER_TARGET_SSE42
+inline void tag_words_sse42(const uintptr_t *addresses, std::size_t n, uintptr_t tag_bits,
+                            uintptr_t *out) {
+    auto tag_vector = _mm_set1_epi64x(static_cast<long long>(tag_bits));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addresses + i));
+        auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addresses + i + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(v0, tag_vector));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), _mm_or_si128(v1, tag_vector));
+    }
+    tag_words_scalar(addresses + i, n - i, tag_bits, out + i);
+}
+
+/* SSE4.2 version of `mask_words_scalar`; handles 4 words per iteration. */
+TAGGED_POINTER_TARGET_SSE42
+inline void mask_words_sse42(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                             uintptr_t *out) {
+    auto mask_vector = _mm_set1_epi64x(static_cast<long long>(mask));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+        auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_and_si128(v0, mask_vector));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), _mm_and_si128(v1, mask_vector));
+    }
+    mask_words_scalar(words + i, n - i, mask, out + i);
+}
+
+/* AVX2 version of `tag_words_scalar`; handles 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX2
+inline void tag_words_avx2(const uintptr_t *addresses, std::size_t n, uintptr_t tag_bits,
+                           uintptr_t *out) {
+    auto tag_vector = _mm256_set1_epi64x(static_cast<long long>(tag_bits));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(addresses + i));
+        auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(addresses + i + 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_or_si256(v0, tag_vector));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4),
+                            _mm256_or_si256(v1, tag_vector));
+    }
+    tag_words_scalar(addresses + i, n - i, tag_bits, out + i);
+}
+
+/* AVX2 version of `mask_words_scalar`; handles 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX2
+inline void mask_words_avx2(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                            uintptr_t *out) {
+    auto mask_vector = _mm256_set1_epi64x(static_cast<long long>(mask));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i + 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_and_si256(v0, mask_vector));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4),
+                            _mm256_and_si256(v1, mask_vector));
+    }
+    mask_words_scalar(words + i, n - i, mask, out + i);
+}
+#endif
+
+#if TAGGED_POINTER_BULK_X86
+/* AVX-512 version of `tag_words_scalar`; handles 16 words per iteration. */
+TAGGED_POINTER_TARGET_AVX512
+inline void tag_words_avx512(const uintptr_t *addresses, std::size_t n, uintptr_t tag_bits,
+                             uintptr_t *out) {
+    auto tag_vector = _mm512_set1_epi64(static_cast<long long>(tag_bits));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto v0 = _mm512_loadu_si512(addresses + i);
+        auto v1 = _mm512_loadu_si512(addresses + i + 8);
+        _mm512_storeu_si512(out + i, _mm512_or_si512(v0, tag_vector));
+        _mm512_storeu_si512(out + i + 8, _mm512_or_si512(v1, tag_vector));
+    }
+    tag_words_scalar(addresses + i, n - i, tag_bits, out + i);
+}
+
+/* AVX-512 version of `mask_words_scalar`; handles 16 words per iteration. */
+TAGGED_POINTER_TARGET_AVX512
+inline void mask_words_avx512(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                              uintptr_t *out) {
+    auto mask_vector = _mm512_set1_epi64(static_cast<long long>(mask));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto v0 = _mm512_loadu_si512(words + i);
+        auto v1 = _mm512_loadu_si512(words + i + 8);
+        _mm512_storeu_si512(out + i, _mm512_and_si512(v0, mask_vector));
+        _mm512_storeu_si512(out + i + 8, _mm512_and_si512(v1, mask_vector));
+    }
+    mask_words_scalar(words + i, n - i, mask, out + i);
+}
+#endif
+
+/* Stores `addresses[i] | tag_bits` into `out[i]`, for all `i` in `[0, n)`, using the kernel for
+`active_bulk_isa()`. */
+inline void tag_words(const uintptr_t *addresses, std::size_t n, uintptr_t tag_bits,
+                      uintptr_t *out) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512: return tag_words_avx512(addresses, n, tag_bits, out);
+        case BulkIsa::AVX2: return tag_words_avx2(addresses, n, tag_bits, out);
+        case BulkIsa::SSE42: return tag_words_sse42(addresses, n, tag_bits, out);
+#endif
+        default: return tag_words_scalar(addresses, n, tag_bits, out);
+    }
+}
+
+/* Stores `words[i] & mask` into `out[i]`, for all `i` in `[0, n)`, using the kernel for
+`active_bulk_isa()`. */
+inline void mask_words(const uintptr_t *words, std::size_t n, uintptr_t mask, uintptr_t *out) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512: return mask_words_avx512(words, n, mask, out);
+        case BulkIsa::AVX2: return mask_words_avx2(words, n, mask, out);
+        case BulkIsa::SSE42: return mask_words_sse42(words, n, mask, out);
+#endif
+        default: return mask_words_scalar(words, n, mask, out);
+    }
+}
+
+/* Returns the smallest `i` in `[0, n)` such that `(words[i] & mask) == value`, or `n` if there is
+no such `i`. */
+inline std::size_t find_masked_scalar(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                      uintptr_t value) {
+    for (std::size_t i = 0; i < n; ++i) {
+        if ((words[i] & mask) == value) {return i;}
+    }
+    return n;
+}
+
+/* Returns the number of `i` in `[0, n)` such that `(words[i] & mask) == value`. */
+inline std::size_t count_masked_scalar(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                       uintptr_t value) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {count += (words[i] & mask) == value;}
+    return count;
+}
+
+#if TAGGED_POINTER_BULK_X86
+/* Returns the bitmask whose `j`th bit is set iff `(words[j] & mask) == value`, for all `j` in
+`[0, 2)`. */
+TAGGED_POINTER_TARGET_SSE42
+inline unsigned match_masked_sse42(const uintptr_t *words, __m128i mask, __m128i value) {
+    auto v = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words)), mask);
+    auto matches = _mm_cmpeq_epi64(v, value);
+    return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(matches)));
+}
+
+/* SSE4.2 version of `find_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_SSE42
+inline std::size_t find_masked_sse42(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                     uintptr_t value) {
+    auto mask_vector = _mm_set1_epi64x(static_cast<long long>(mask));
+    auto value_vector = _mm_set1_epi64x(static_cast<long long>(value));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned matches = 0;
+        for (int k = 0; k < 4; ++k) {
+            matches |= match_masked_sse42(words + i + 2 * k, mask_vector, value_vector) << (2 * k);
+        }
+        if (matches != 0) {return i + static_cast<std::size_t>(__builtin_ctz(matches));}
+    }
+    return i + find_masked_scalar(words + i, n - i, mask, value);
+}
+
+/* SSE4.2 version of `count_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_SSE42
+inline std::size_t count_masked_sse42(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                      uintptr_t value) {
+    auto mask_vector = _mm_set1_epi64x(static_cast<long long>(mask));
+    auto value_vector = _mm_set1_epi64x(static_cast<long long>(value));
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned matches = 0;
+        for (int k = 0; k < 4; ++k) {
+            matches |= match_masked_sse42(words + i + 2 * k, mask_vector, value_vector) << (2 * k);
+        }
+        count += static_cast<std::size_t>(__builtin_popcount(matches));
+    }
+    return count + count_masked_scalar(words + i, n - i, mask, value);
+}
+
+/* Returns the bitmask whose `j`th bit is set iff `(words[j] & mask) == value`, for all `j` in
+`[0, 4)`. */
+TAGGED_POINTER_TARGET_AVX2
+inline unsigned match_masked_avx2(const uintptr_t *words, __m256i mask, __m256i value) {
+    auto v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words)), mask);
+    auto matches = _mm256_cmpeq_epi64(v, value);
+    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(matches)));
+}
+
+/* AVX2 version of `find_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX2
+inline std::size_t find_masked_avx2(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                    uintptr_t value) {
+    auto mask_vector = _mm256_set1_epi64x(static_cast<long long>(mask));
+    auto value_vector = _mm256_set1_epi64x(static_cast<long long>(value));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto matches = match_masked_avx2(words + i, mask_vector, value_vector)
+                     | (match_masked_avx2(words + i + 4, mask_vector, value_vector) << 4);
+        if (matches != 0) {return i + static_cast<std::size_t>(__builtin_ctz(matches));}
+    }
+    return i + find_masked_scalar(words + i, n - i, mask, value);
+}
+
+/* AVX2 version of `count_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX2
+inline std::size_t count_masked_avx2(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                     uintptr_t value) {
+    auto mask_vector = _mm256_set1_epi64x(static_cast<long long>(mask));
+    auto value_vector = _mm256_set1_epi64x(static_cast<long long>(value));
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto matches = match_masked_avx2(words + i, mask_vector, value_vector)
+                     | (match_masked_avx2(words + i + 4, mask_vector, value_vector) << 4);
+        count += static_cast<std::size_t>(__builtin_popcount(matches));
+    }
+    return count + count_masked_scalar(words + i, n - i, mask, value);
+}
+#endif
+
+#if TAGGED_POINTER_BULK_X86
+/* AVX-512 version of `find_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX512
+inline std::size_t find_masked_avx512(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                      uintptr_t value) {
+    auto mask_vector = _mm512_set1_epi64(static_cast<long long>(mask));
+    auto value_vector = _mm512_set1_epi64(static_cast<long long>(value));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v = _mm512_and_si512(_mm512_loadu_si512(words + i), mask_vector);
+        unsigned matches = _mm512_cmpeq_epi64_mask(v, value_vector);
+        if (matches != 0) {return i + static_cast<std::size_t>(__builtin_ctz(matches));}
+    }
+    return i + find_masked_scalar(words + i, n - i, mask, value);
+}
+
+/* AVX-512 version of `count_masked_scalar`; checks 8 words per iteration. */
+TAGGED_POINTER_TARGET_AVX512
+inline std::size_t count_masked_avx512(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                       uintptr_t value) {
+    auto mask_vector = _mm512_set1_epi64(static_cast<long long>(mask));
+    auto value_vector = _mm512_set1_epi64(static_cast<long long>(value));
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v = _mm512_and_si512(_mm512_loadu_si512(words + i), mask_vector);
+        unsigned matches = _mm512_cmpeq_epi64_mask(v, value_vector);
+        count += static_cast<std::size_t>(__builtin_popcount(matches));
+    }
+    return count + count_masked_scalar(words + i, n - i, mask, value);
+}
+#endif
+
+/* Returns the smallest `i` in `[0, n)` such that `(words[i] & mask) == value`, or `n` if there is
+no such `i`, using the kernel for `active_bulk_isa()`. */
+inline std::size_t find_masked(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                               uintptr_t value) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512: return find_masked_avx512(words, n, mask, value);
+        case BulkIsa::AVX2: return find_masked_avx2(words, n, mask, value);
+        case BulkIsa::SSE42: return find_masked_sse42(words, n, mask, value);
+#endif
+        default: return find_masked_scalar(words, n, mask, value);
+    }
+}
+
+/* Returns the number of `i` in `[0, n)` such that `(words[i] & mask) == value`, using the kernel
+for `active_bulk_isa()`. */
+inline std::size_t count_masked(const uintptr_t *words, std::size_t n, uintptr_t mask,
+                                uintptr_t value) {
+    switch (active_bulk_isa()) {
+#if TAGGED_POINTER_BULK_X86
+        case BulkIsa::AVX512: return count_masked_avx512(words, n, mask, value);
+        case BulkIsa::AVX2: return count_masked_avx2(words, n, mask, value);
+        case BulkIsa::SSE42: return count_masked_sse42(words, n, mask, value);
+#endif
+        default: return count_masked_scalar(words, n, mask, value);
+    }
+}
+
+/* Stably sorts `words[0, n)` by tag with a counting sort, using `scratch[0, n)` as temporary
+storage. `counts` must hold the result of `tag_histogram` on `words`. The destination of each
+word is found from its tag, which is extracted with the SIMD kernels one block at a time. */
+inline void partition_by_tag(uintptr_t *words, uintptr_t *scratch, std::size_t n,
+                             const uint64_t *counts, unsigned num_tags) {
+    std::size_t offsets[NUM_BULK_TAGS];
+    std::size_t offset = 0;
+    for (unsigned t = 0; t < num_tags; ++t) {
+        offsets[t] = offset;
+        offset += static_cast<std::size_t>(counts[t]);
+    }
+
+    uint8_t tags[BULK_BLOCK_SIZE];
+    for (std::size_t i = 0; i < n; i += BULK_BLOCK_SIZE) {
+        auto block_size = n - i < BULK_BLOCK_SIZE ? n - i : BULK_BLOCK_SIZE;
+        extract_tags(words + i, block_size, tags);
+        for (std::size_t j = 0; j < block_size; ++j) {
+            scratch[offsets[tags[j]]++] = words[i + j];
+        }
+    }
+    std::copy(scratch, scratch + n, words);
+}
+
+/* Stably sorts `data[0, n)` by `key(element)`, an unsigned integer of at most 64 bits, with a
+least-significant-digit radix sort using 8-bit digits, and `scratch[0, n)` as temporary storage.
+Digits that are the same for every key (such as the top bytes of user-space addresses) are
+skipped entirely, so sorting typically takes far fewer than 8 passes. */
+template <typename T, typename KeyFunc>
+void radix_sort(T *data, T *scratch, std::size_t n, KeyFunc key) {
+    uint64_t keys_or = 0, keys_and = ~uint64_t{0};
+    for (std::size_t i = 0; i < n; ++i) {
+        keys_or |= key(data[i]);
+        keys_and &= key(data[i]);
+    }
+    auto varying_bits = keys_or ^ keys_and;
+
+    auto src = data, dst = scratch;
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        if (((varying_bits >> shift) & 0xFF) == 0) {continue;}
+
+        std::size_t offsets[256] = {};
+        for (std::size_t i = 0; i < n; ++i) {++offsets[(key(src[i]) >> shift) & 0xFF];}
+        std::size_t offset = 0;
+        for (auto &digit_offset : offsets) {
+            auto count = digit_offset;
+            digit_offset = offset;
+            offset += count;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[offsets[(key(src[i]) >> shift) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != data) {std::copy(src, src + n, data);}
+}
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Stores `tagged_ptrs[i].tag()` into `out[i]`, for every `i`. `out` must have room for
+`tagged_ptrs.size()` elements. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+void extract_tags(std::span<const TP> tagged_ptrs, uint8_t *out) {
+    detail::extract_tags(detail::words_of(tagged_ptrs), tagged_ptrs.size(), out);
+}
+
+/* Returns the number of elements of `tagged_ptrs` with each tag; that is, the `t`th element of
+the returned array is the number of elements whose `tag()` equals `t`. Index 0 thus counts the
+tagged null pointers, and index `TP::get_tag_of_type<T>()` counts the pointers to `T`. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+std::array<std::size_t, TP::num_types() + 1> tag_histogram(std::span<const TP> tagged_ptrs) {
+    constexpr unsigned num_tags = TP::num_types() + 1;
+    uint64_t counts[num_tags] = {};
+    detail::tag_histogram(detail::words_of(tagged_ptrs), tagged_ptrs.size(), counts, num_tags);
+
+    std::array<std::size_t, num_tags> result;
+    for (unsigned t = 0; t < num_tags; ++t) {result[t] = static_cast<std::size_t>(counts[t]);}
+    return result;
+}
+
+/* `TagPartition<TP>` holds one sub-range of a partitioned array of `TP`s per tag; the `t`th
+sub-range holds exactly the elements with tag `t`. */
+template <typename TP>
+using TagPartition = std::array<std::span<TP>, TP::num_types() + 1>;
+
+/* Reorders `tagged_ptrs` so that elements with equal tags are contiguous, in increasing order of
+tag, and returns the sub-range for each tag. `scratch` is used as temporary storage, and must hold
+at least `tagged_ptrs.size()` elements.
+
+If `sort_by_address` is `false`, elements with equal tags keep their relative order (the sort is a
+stable counting sort on the tag bits). If it is `true`, elements with equal tags are additionally
+sorted by address, which improves the memory locality of a subsequent pass over each sub-range.
+Since the tag occupies the most significant bits of `tagged_address`, this is simply a radix sort
+of the `tagged_address`es. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+TagPartition<TP> partition_by_tag(std::span<TP> tagged_ptrs, std::span<uintptr_t> scratch,
+                                  bool sort_by_address = false) {
+    assert(scratch.size() >= tagged_ptrs.size()
+           && "`scratch` must hold at least as many elements as `tagged_ptrs`");
+    constexpr unsigned num_tags = TP::num_types() + 1;
+    auto words = detail::words_of(tagged_ptrs);
+    auto n = tagged_ptrs.size();
+
+    uint64_t counts[num_tags] = {};
+    detail::tag_histogram(words, n, counts, num_tags);
+    if (sort_by_address) {
+        detail::radix_sort(words, scratch.data(), n, [](uintptr_t word) {return word;});
+    } else {
+        detail::partition_by_tag(words, scratch.data(), n, counts, num_tags);
+    }
+
+    TagPartition<TP> result;
+    std::size_t offset = 0;
+    for (unsigned t = 0; t < num_tags; ++t) {
+        result[t] = tagged_ptrs.subspan(offset, static_cast<std::size_t>(counts[t]));
+        offset += static_cast<std::size_t>(counts[t]);
+    }
+    return result;
+}
+
+/* Same as the overload above, but allocates its own temporary storage. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+TagPartition<TP> partition_by_tag(std::span<TP> tagged_ptrs, bool sort_by_address = false) {
+    std::vector<uintptr_t> scratch(tagged_ptrs.size());
+    return partition_by_tag(tagged_ptrs, std::span<uintptr_t>{scratch}, sort_by_address);
+}
+
+/* Stores a `TP` pointing to `ptrs[i]` into `out[i]`, for every `i`; that is, does the same as
+`out[i] = TP(ptrs[i])`, but tags many pointers at once by ORing the tag of `T` into them.
+`out` must have room for `ptrs.size()` elements.
+
+Like the bulk kernels in general, this treats the array of `T*` as an array of addresses,
+which is valid on every platform with the SIMD instructions used here (see the comments in
+`TaggedPointer::cast_unchecked` on why this is not valid in general). */
+template <typename T, typename TP>
+requires detail::TaggedPointerLike<TP>
+      && requires {TP::template get_tag_of_type<std::remove_const_t<T>>();}
+void tag_all(std::span<T* const> ptrs, TP *out) {
+    static_assert(sizeof(T*) == sizeof(uintptr_t), "Bulk tagging requires flat addresses");
+    constexpr auto tag = TP::template get_tag_of_type<std::remove_const_t<T>>();
+    constexpr auto tag_bits = static_cast<uintptr_t>(tag)
+                            << detail::TaggedPointerAccess::tag_shift<TP>();
+    detail::tag_words(reinterpret_cast<const uintptr_t*>(ptrs.data()), ptrs.size(), tag_bits,
+                      detail::words_of(std::span<TP>{out, ptrs.size()}));
+}
+
+/* Stores `tagged_ptrs[i].ptr()` into `out[i]`, for every `i`, by masking off the tag bits of many
+`TaggedPointer`s at once. `out` must have room for `tagged_ptrs.size()` elements. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+void untag_all(std::span<const TP> tagged_ptrs, void **out) {
+    static_assert(sizeof(void*) == sizeof(uintptr_t), "Bulk untagging requires flat addresses");
+    detail::mask_words(detail::words_of(tagged_ptrs), tagged_ptrs.size(),
+                       detail::TaggedPointerAccess::ptr_mask<TP>(),
+                       reinterpret_cast<uintptr_t*>(out));
+}
+
+/* Returns the index of the first element of `tagged_ptrs` equal to `value`, or `tagged_ptrs.size()`
+if there is none. Compares whole `tagged_address`es, several at a time. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+std::size_t find(std::span<const TP> tagged_ptrs, const TP &value) {
+    return detail::find_masked(detail::words_of(tagged_ptrs), tagged_ptrs.size(), ~uintptr_t{0},
+                               detail::TaggedPointerAccess::bits(value));
+}
+
+/* Returns the index of the first element of `tagged_ptrs` that points to a `T`, or
+`tagged_ptrs.size()` if there is none. Compares only the tag bits, several elements at a time. */
+template <typename T, typename TP>
+requires detail::TaggedPointerLike<TP> && requires {TP::template get_tag_of_type<T>();}
+std::size_t find_first_of_type(std::span<const TP> tagged_ptrs) {
+    using Access = detail::TaggedPointerAccess;
+    return detail::find_masked(detail::words_of(tagged_ptrs), tagged_ptrs.size(),
+                               ~Access::ptr_mask<TP>(),
+                               static_cast<uintptr_t>(TP::template get_tag_of_type<T>())
+                               << Access::tag_shift<TP>());
+}
+
+/* Returns the number of elements of `tagged_ptrs` that point to a `T`. Compares only the tag bits,
+several elements at a time. */
+template <typename T, typename TP>
+requires detail::TaggedPointerLike<TP> && requires {TP::template get_tag_of_type<T>();}
+std::size_t count_type(std::span<const TP> tagged_ptrs) {
+    using Access = detail::TaggedPointerAccess;
+    return detail::count_masked(detail::words_of(tagged_ptrs), tagged_ptrs.size(),
+                                ~Access::ptr_mask<TP>(),
+                                static_cast<uintptr_t>(TP::template get_tag_of_type<T>())
+                                << Access::tag_shift<TP>());
+}
@@ -0,0 +1,141 @@
+/* Implements conversions between `TaggedPointer`s with different type packs, such as from
+`TaggedPointer<Circle, Rectangle>` to `TaggedPointer<Circle, RightTriangle, Rectangle>`. Since the
+pointed-to address never changes, a conversion only needs to remap the tag, and the remapping is
+computed entirely at compile-time from the two type packs:
+- If every type keeps its tag, the conversion is a plain copy.
+- If every type's tag is shifted by the same amount, the conversion is a single addition.
+- Otherwise, the new tag is looked up in a small table indexed by the old tag.
+
+`widen` converts to a `TaggedPointer` that can point to every type the source can point to, and
+so always succeeds. `narrow` converts to any other `TaggedPointer`, and returns an empty
+`TaggedOptional` if the source points to a type outside the target's type pack. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`
+#include <span>             // For `std::span`
+#include "tagged_pointer.h"
+#include "tagged_optional.h"
+
+namespace detail {
+
+/* `TagRemap<From, To>` describes how to convert the tags of the `TaggedPointer` `From` into the
+tags of the `TaggedPointer` `To`. */
+template <typename From, typename To>
+struct TagRemap;
+
+template <typename... Us, typename... Vs>
+struct TagRemap<TaggedPointer<Us...>, TaggedPointer<Vs...>> {
+    using From = TaggedPointer<Us...>;
+    using To = TaggedPointer<Vs...>;
+
+    /* `INVALID` marks, in `table`, the tags of types in `Us...` that are not in `Vs...`. */
+    constexpr static unsigned char INVALID = 0xFF;
+
+    /* `table[tag]` is the tag in `To` of the type with tag `tag` in `From`, or `INVALID` if that
+    type is not one of `Vs...`. The null tag always maps to itself. Tags that `From` never uses
+    are mapped to `INVALID` as well. */
+    constexpr static std::array<unsigned char, From::max_tag() + 1> table = [] {
+        std::array<unsigned char, From::max_tag() + 1> result;
+        result.fill(INVALID);
+        result[0] = 0;
+        ((result[From::template get_tag_of_type<Us>()] = [] {
+            if constexpr (ContainsType<Us, Vs...>) {
+                return static_cast<unsigned char>(To::template get_tag_of_type<Us>());
+            } else {
+                return INVALID;
+            }
+        }()), ...);
+        return result;
+    }();
+
+    /* `is_widening` is `true` iff every type in `Us...` is also in `Vs...`. */
+    constexpr static bool is_widening = (ContainsType<Us, Vs...> && ...);
+
+    /* `offset` is the difference between the tags of the first type of `Us...` in `To` and in
+    `From` (or 0 if there is no such type), and `is_affine` is `true` iff every type in `Us...`
+    has its tag shifted by exactly `offset`. */
+    constexpr static int offset = [] {
+        if constexpr (sizeof...(Us) == 0) {return 0;} else {return int{table[1]} - 1;}
+    }();
+    constexpr static bool is_affine = is_widening && [] {
+        for (unsigned tag = 1; tag <= From::num_types(); ++tag) {
+            if (int{table[tag]} != int(tag) + offset) {return false;}
+        }
+        return true;
+    }();
+
+    /* Returns the `tagged_address` in `To` of the pointer with `tagged_address` `bits` in `From`.
+    Must only be called if the pointed-to type is one of `Vs...`. */
+    static uintptr_t remap(uintptr_t bits) {
+        constexpr auto shift = TaggedPointerAccess::tag_shift<From>();
+        if constexpr (is_affine && offset == 0) {
+            return bits;
+        } else if constexpr (is_affine) {
+            /* Every tag except the null tag moves by `offset`. Unsigned wraparound makes this
+            correct even if `offset` is negative. */
+            auto is_non_null = static_cast<uintptr_t>((bits >> shift) != 0);
+            return bits + ((is_non_null * static_cast<uintptr_t>(offset)) << shift);
+        } else {
+            return (bits & TaggedPointerAccess::ptr_mask<From>())
+                 | (static_cast<uintptr_t>(table[bits >> shift]) << shift);
+        }
+    }
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Converts `from` to a `To`, where `To` is a `TaggedPointer` (or a type inheriting from one) that
+can point to every type `From` can point to. */
+template <typename To, typename From>
+requires detail::TaggedPointerLike<To> && detail::TaggedPointerLike<From>
+      && detail::TagRemap<detail::TaggedPointerBase_t<From>,
+                          detail::TaggedPointerBase_t<To>>::is_widening
+To widen(const From &from) {
+    using Access = detail::TaggedPointerAccess;
+    using Remap = detail::TagRemap<detail::TaggedPointerBase_t<From>,
+                                   detail::TaggedPointerBase_t<To>>;
+    return Access::from_bits<To>(Remap::remap(Access::bits(from)));
+}
+
+/* Converts `from` to a `To`, where `To` is a `TaggedPointer` (or a type inheriting from one).
+Returns an empty `TaggedOptional` iff `from` points to a type `To` cannot point to. A tagged null
+pointer is always converted to a tagged null pointer. */
+template <typename To, typename From>
+requires detail::TaggedPointerLike<To> && detail::TaggedPointerLike<From>
+TaggedOptional<To> narrow(const From &from) {
+    using Access = detail::TaggedPointerAccess;
+    using Remap = detail::TagRemap<detail::TaggedPointerBase_t<From>,
+                                   detail::TaggedPointerBase_t<To>>;
+    if (Remap::table[from.tag()] == Remap::INVALID) {return std::nullopt;}
+    return Access::from_bits<To>(Remap::remap(Access::bits(from)));
+}
+
+/* Converts every element of `from` with `widen`, storing the results in `out`, which must have
+room for `from.size()` elements. When the conversion is a copy or an addition (see the top of
+this file), the loop body is branch-free and is vectorized by the compiler. */
+template <typename To, typename From>
+requires detail::TaggedPointerLike<To> && detail::TaggedPointerLike<From>
+      && detail::TagRemap<detail::TaggedPointerBase_t<From>,
+                          detail::TaggedPointerBase_t<To>>::is_widening
+void widen_all(std::span<const From> from, To *out) {
+    for (std::size_t i = 0; i < from.size(); ++i) {
+        out[i] = widen<To>(from[i]);
+    }
+}
+
+/* Converts every element of `from` with `narrow`, storing the results in `out`, which must have
+room for `from.size()` elements. Returns the number of elements that were converted successfully
+(that is, the number of non-empty results). */
+template <typename To, typename From>
+requires detail::TaggedPointerLike<To> && detail::TaggedPointerLike<From>
+std::size_t narrow_all(std::span<const From> from, TaggedOptional<To> *out) {
+    std::size_t num_converted = 0;
+    for (std::size_t i = 0; i < from.size(); ++i) {
+        out[i] = narrow<To>(from[i]);
+        num_converted += out[i].has_value();
+    }
+    return num_converted;
+}
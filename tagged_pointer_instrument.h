@@ -0,0 +1,235 @@
+/* Implements the optional instrumentation of dispatches: when `TAGGED_POINTER_INSTRUMENT` is
+defined (before including "tagged_pointer.h", and identically in every translation unit), every
+dispatch counts, per call site and per type, how many times each type was dispatched to. If
+`TAGGED_POINTER_INSTRUMENT_LATENCY` is defined as well, each dispatch is also timed (with `rdtsc`
+on x86, and `std::chrono::steady_clock` elsewhere), and the latencies are gathered into a histogram
+with power-of-two buckets. When `TAGGED_POINTER_INSTRUMENT` is not defined, this header is not
+included at all, so the generated code is exactly what it would be without instrumentation.
+
+The dispatches counted are those of `call` (with or without `hot`), `call_if`, `call_all`,
+`NonNullTaggedPointer::call` and everything built on them (such as `prefetching_for_each` and
+`RunIndex`); the hits of an `InlineCache`, at the same site as its misses; `invoke<Op>`, at a site
+named after `Op`; and each instruction run by `run_threaded`. Not counted are `dispatch` and
+`dispatch_symmetric` (see multiple_dispatch.h), which dispatch on a combination of types rather
+than on one type, and `CommandBuffer::flush` (see command_buffer.h), which dispatches once per
+group of commands rather than once per command.
+
+A call site is identified by the type of the function object passed to `call` together with the
+`TaggedPointer`'s types; since every lambda expression has a distinct type, this is one site per
+lambda. The counters are thread-local, so counting a dispatch is just a load and a store, with no
+atomic read-modify-write and no sharing of cache lines between threads. Each thread's counters are
+registered (under a mutex, once per thread and site) in a global registry, which `dispatch_report`
+merges into a single report on demand, and which outlives the threads themselves. */
+
+#pragma once
+
+#include <algorithm>        // For `std::sort`, `std::find`
+#include <array>            // For `std::array`
+#include <atomic>           // For `std::atomic`
+#include <bit>              // For `std::bit_width`
+#include <chrono>           // For `std::chrono::steady_clock`
+#include <cstddef>          // For `std::size_t`, `std::ptrdiff_t`
+#include <cstdint>          // For `uint64_t`
+#include <initializer_list> // For `std::initializer_list`
+#include <memory>           // For `std::unique_ptr`
+#include <mutex>            // For `std::mutex`, `std::lock_guard`
+#include <ostream>          // For `std::ostream`
+#include <string_view>      // For `std::string_view`
+#include <vector>           // For `std::vector`
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>      // For `__rdtsc`
+#endif
+
+/* `NUM_LATENCY_BUCKETS` is the number of buckets of a latency histogram. Bucket 0 counts
+latencies of 0 ticks, and bucket `b > 0` latencies in `[2^(b - 1), 2^b)` ticks, where a tick is a
+cycle of the timestamp counter on x86, and a nanosecond elsewhere. */
+constexpr std::size_t NUM_LATENCY_BUCKETS = 65;
+
+/* `DispatchTypeReport` holds the merged counters of one type at one call site. `latency` is all
+zeros unless `TAGGED_POINTER_INSTRUMENT_LATENCY` is defined. */
+struct DispatchTypeReport {
+    std::string_view type;
+    uint64_t calls;
+    std::array<uint64_t, NUM_LATENCY_BUCKETS> latency;
+};
+
+/* `DispatchSiteReport` holds the merged counters of one call site, named after the type of the
+function object passed to `call` there. */
+struct DispatchSiteReport {
+    std::string_view site;
+    uint64_t calls;
+    std::vector<DispatchTypeReport> types;
+};
+
+namespace detail {
+
+template <typename T>
+constexpr std::string_view type_name();
+
+/* `DispatchSiteCounters` holds the counters of one call site, for one thread. They are only ever
+written by that thread, but are atomic so that `dispatch_report` may read them concurrently. */
+struct DispatchSiteCounters {
+    const void *key;
+    std::string_view site;
+    std::vector<std::string_view> types;
+    std::vector<std::atomic<uint64_t>> calls;
+    std::vector<std::atomic<uint64_t>> latency;
+
+    DispatchSiteCounters(const void *key, std::string_view site,
+                         std::initializer_list<std::string_view> types)
+        : key(key), site(site), types(types), calls(types.size()),
+          latency(types.size() * NUM_LATENCY_BUCKETS) {}
+};
+
+/* `DispatchRegistry` owns the counters of every thread and call site. */
+struct DispatchRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<DispatchSiteCounters>> counters;
+};
+
+/* Returns the global `DispatchRegistry`. It is deliberately never destroyed, so that threads that
+are still running during static destruction can keep counting. */
+inline DispatchRegistry &dispatch_registry() {
+    static auto *registry = new DispatchRegistry;
+    return *registry;
+}
+
+/* Registers, and returns, new counters for the calling thread at the call site `key`. */
+inline DispatchSiteCounters &register_dispatch_site(const void *key, std::string_view site,
+                                                    std::initializer_list<std::string_view> types) {
+    auto &registry = dispatch_registry();
+    std::lock_guard lock(registry.mutex);
+    return *registry.counters.emplace_back(
+        std::make_unique<DispatchSiteCounters>(key, site, types));
+}
+
+/* Increments `counter`, which only the calling thread writes to, without a read-modify-write. */
+inline void bump(std::atomic<uint64_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/* Returns the current value of the timestamp counter (on x86) or of `std::chrono::steady_clock`,
+in nanoseconds (elsewhere). */
+inline uint64_t read_timestamp() {
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    return __rdtsc();
+#else
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+#endif
+}
+
+/* Returns the counters of the calling thread at the call site of `Func` over `Ts...`, registering
+them on first use. */
+template <typename Func, typename... Ts>
+DispatchSiteCounters &dispatch_site() {
+    static constexpr char key = 0;
+    thread_local DispatchSiteCounters &counters = register_dispatch_site(
+        &key, type_name<Func>(), {type_name<Ts>()...});
+    return counters;
+}
+
+/* `DispatchProbe` counts a dispatch to the `type_index`th type at a call site on construction,
+and, if `TAGGED_POINTER_INSTRUMENT_LATENCY` is defined, records its latency on destruction.
+Dispatches with an out-of-range `type_index` (that is, on tagged null pointers) are not counted. */
+class DispatchProbe {
+    DispatchSiteCounters &counters;
+    unsigned type_index;
+#ifdef TAGGED_POINTER_INSTRUMENT_LATENCY
+    uint64_t start;
+#endif
+
+public:
+
+    DispatchProbe(DispatchSiteCounters &counters, unsigned type_index)
+        : counters(counters), type_index(type_index) {
+        if (type_index < counters.calls.size()) {bump(counters.calls[type_index]);}
+#ifdef TAGGED_POINTER_INSTRUMENT_LATENCY
+        start = read_timestamp();
+#endif
+    }
+
+    ~DispatchProbe() {
+#ifdef TAGGED_POINTER_INSTRUMENT_LATENCY
+        auto ticks = read_timestamp() - start;
+        if (type_index < counters.calls.size()) {
+            bump(counters.latency[type_index * NUM_LATENCY_BUCKETS + std::bit_width(ticks)]);
+        }
+#endif
+    }
+
+    DispatchProbe(const DispatchProbe&) = delete;
+    DispatchProbe &operator= (const DispatchProbe&) = delete;
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Returns the counters of every call site, summed over all threads (including threads that have
+exited), with the sites sorted by decreasing number of calls. */
+inline std::vector<DispatchSiteReport> dispatch_report() {
+    auto &registry = detail::dispatch_registry();
+    std::lock_guard lock(registry.mutex);
+
+    std::vector<const void*> keys;
+    std::vector<DispatchSiteReport> result;
+    for (auto &counters : registry.counters) {
+        auto site = std::find(keys.begin(), keys.end(), counters->key) - keys.begin();
+        if (site == static_cast<std::ptrdiff_t>(keys.size())) {
+            keys.push_back(counters->key);
+            auto &report = result.emplace_back(DispatchSiteReport{counters->site, 0, {}});
+            for (auto type : counters->types) {report.types.push_back({type, 0, {}});}
+        }
+        auto &report = result[site];
+        for (std::size_t t = 0; t < report.types.size(); ++t) {
+            auto calls = counters->calls[t].load(std::memory_order_relaxed);
+            report.types[t].calls += calls;
+            report.calls += calls;
+            auto latency = counters->latency.data() + t * NUM_LATENCY_BUCKETS;
+            for (std::size_t b = 0; b < NUM_LATENCY_BUCKETS; ++b) {
+                report.types[t].latency[b] += latency[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+        return a.calls > b.calls;
+    });
+    return result;
+}
+
+/* Resets the counters of every call site to zero. Counts made by other threads while this runs
+may be lost, or survive the reset. */
+inline void reset_dispatch_report() {
+    auto &registry = detail::dispatch_registry();
+    std::lock_guard lock(registry.mutex);
+    for (auto &counters : registry.counters) {
+        for (auto &counter : counters->calls) {counter.store(0, std::memory_order_relaxed);}
+        for (auto &counter : counters->latency) {counter.store(0, std::memory_order_relaxed);}
+    }
+}
+
+/* Writes `report` to `out` in a human-readable form: one line per call site, followed by one line
+per type that was dispatched to, with its share of the calls and, if any latencies were recorded,
+its median latency bucket. */
+inline void write_dispatch_report(std::ostream &out,
+                                  const std::vector<DispatchSiteReport> &report) {
+    for (auto &site : report) {
+        out << site.site << ": " << site.calls << " calls\n";
+        for (auto &type : site.types) {
+            if (type.calls == 0) {continue;}
+            out << "    " << type.type << ": " << type.calls << " ("
+                << 100.0 * static_cast<double>(type.calls) / static_cast<double>(site.calls)
+                << "%)";
+            uint64_t timed = 0, seen = 0;
+            for (auto count : type.latency) {timed += count;}
+            for (std::size_t b = 0; b < NUM_LATENCY_BUCKETS && timed > 0; ++b) {
+                seen += type.latency[b];
+                if (2 * seen >= timed) {
+                    out << ", median latency < 2^" << b << " ticks";
+                    break;
+                }
+            }
+            out << '\n';
+        }
+    }
+}
@@ -0,0 +1,182 @@
+/* Implements interleaved execution of independent lookups (tree descents, hash probes, and the
+like) over structures linked by `TaggedPointer`s, using C++20 coroutines. Each lookup is written
+as a coroutine returning an `InterleavedTask<R>`, which, before following a pointer to the next
+node, prefetches it and suspends itself with `co_await prefetch_and_yield(next)`:
+
+    InterleavedTask<const Leaf*> find_leaf(Node node, Key key) {
+        while (!node.points_to_type<Leaf>()) {
+            co_await prefetch_and_yield(node);
+            node = node.call([&](auto *inner) {return inner->child(key);});
+        }
+        co_return node.cast<Leaf>();
+    }
+
+`run_interleaved` then keeps several lookups in flight at once, resuming them round-robin. By the
+time a lookup is resumed, the others have taken their turn, and the node it prefetched has most
+likely arrived in the cache, so the cache misses of all the lookups in flight overlap instead of
+being paid one after the other. This is the "asynchronous memory access chaining" technique. Each
+task allocates a coroutine frame, so it pays off when each lookup misses the cache several times. */
+
+#pragma once
+
+#include <coroutine>        // For `std::coroutine_handle`, `std::suspend_always`
+#include <cstddef>          // For `std::size_t`
+#include <exception>        // For `std::exception_ptr`
+#include <optional>         // For `std::optional`
+#include <type_traits>      // For `std::invoke_result_t`
+#include <utility>          // For `std::move`, `std::exchange`
+#include <vector>           // For `std::vector`
+#include "tagged_pointer.h"
+#include "tagged_pointer_prefetch.h"
+
+namespace detail {
+
+/* `InterleavedPromiseBase<R>` stores the result of an `InterleavedTask<R>`. It is specialized for
+`void` below, since coroutines must define either `return_value` or `return_void`, never both. */
+template <typename R>
+struct InterleavedPromiseBase {
+    std::optional<R> result;
+
+    void return_value(R value) {result.emplace(std::move(value));}
+    R take_result() {return std::move(*result);}
+};
+
+template <>
+struct InterleavedPromiseBase<void> {
+    void return_void() {}
+    void take_result() {}
+};
+
+/* `PrefetchAndYield<TP>` is the awaitable returned by `prefetch_and_yield`. */
+template <typename TP>
+struct PrefetchAndYield {
+    TP tagged_ptr;
+
+    bool await_ready() const noexcept {return false;}
+    void await_suspend(std::coroutine_handle<>) const noexcept {
+        prefetch_pointee(tagged_ptr);
+    }
+    void await_resume() const noexcept {}
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `InterleavedTask<R>` is the return type of a lookup coroutine that produces an `R` (possibly
+`void`). The coroutine starts suspended, and only runs when resumed by `run_interleaved` (or by
+`resume`). `InterleavedTask` owns the coroutine frame, and is move-only. */
+template <typename R>
+class InterleavedTask {
+public:
+
+    struct promise_type : detail::InterleavedPromiseBase<R> {
+        std::exception_ptr exception;
+
+        InterleavedTask get_return_object() {
+            return InterleavedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {return {};}
+        std::suspend_always final_suspend() noexcept {return {};}
+        void unhandled_exception() {exception = std::current_exception();}
+    };
+
+private:
+
+    /* `handle` refers to the coroutine frame owned by this task, or is null if this task is
+    empty. */
+    std::coroutine_handle<promise_type> handle;
+
+    explicit InterleavedTask(std::coroutine_handle<promise_type> handle) : handle{handle} {}
+
+public:
+
+    /* Returns `true` iff this task holds a coroutine. */
+    bool valid() const {return static_cast<bool>(handle);}
+
+    /* Returns `true` iff the coroutine has finished. Must only be called if `valid()`. */
+    bool done() const {return handle.done();}
+
+    /* Runs the coroutine until it suspends or finishes. Must only be called if `valid()` and
+    `!done()`. */
+    void resume() {handle.resume();}
+
+    /* Returns the result of the finished coroutine, moving it out, or rethrows the exception it
+    exited with. Must only be called once, after `done()` returns `true`. */
+    R result() {
+        if (handle.promise().exception) {std::rethrow_exception(handle.promise().exception);}
+        return handle.promise().take_result();
+    }
+
+    InterleavedTask &operator= (InterleavedTask &&other) noexcept {
+        if (this != &other) {
+            if (handle) {handle.destroy();}
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    InterleavedTask(InterleavedTask &&other) noexcept
+        : handle{std::exchange(other.handle, nullptr)} {}
+
+    /* Constructs an empty task. */
+    InterleavedTask() : handle{nullptr} {}
+
+    ~InterleavedTask() {
+        if (handle) {handle.destroy();}
+    }
+};
+
+/* Returns an awaitable that prefetches the object pointed to by `tagged_ptr` (as much of it as
+`prefetching_for_each` would), then suspends the awaiting lookup so the other lookups in flight
+can run. `TP` is a `TaggedPointer`, or a type that inherits from one. */
+template <typename TP>
+requires detail::TaggedPointerLike<TP>
+detail::PrefetchAndYield<TP> prefetch_and_yield(const TP &tagged_ptr) {return {tagged_ptr};}
+
+/* `DEFAULT_INTERLEAVE_WIDTH` is the default number of lookups `run_interleaved` keeps in flight;
+about the number of cache misses a core can have outstanding at once. */
+constexpr std::size_t DEFAULT_INTERLEAVE_WIDTH = 8;
+
+/* Runs the `num_lookups` lookups `make_task(0)`, ..., `make_task(num_lookups - 1)`, each of which
+returns an `InterleavedTask<R>`, keeping up to `width` of them in flight at once and resuming them
+round-robin. When lookup `i` finishes, `on_result(i, result)` is called (or `on_result(i)`, if `R`
+is `void`); lookups may finish in any order. A lookup is only created once a slot is free, so at
+most `width` coroutine frames are alive at any time. With `width == 1`, the lookups simply run one
+after the other. */
+template <typename MakeTask, typename OnResult>
+void run_interleaved(std::size_t num_lookups, MakeTask &&make_task, OnResult &&on_result,
+                     std::size_t width = DEFAULT_INTERLEAVE_WIDTH) {
+    using Task = std::invoke_result_t<MakeTask&, std::size_t>;
+    if (width == 0) {width = 1;}
+
+    std::vector<Task> slots(width < num_lookups ? width : num_lookups);
+    std::vector<std::size_t> slot_lookups(slots.size());
+    std::size_t num_started = 0;
+    for (std::size_t s = 0; s < slots.size(); ++s) {
+        slot_lookups[s] = num_started;
+        slots[s] = make_task(num_started++);
+    }
+
+    auto num_in_flight = slots.size();
+    while (num_in_flight > 0) {
+        for (std::size_t s = 0; s < slots.size(); ++s) {
+            auto &task = slots[s];
+            if (!task.valid()) {continue;}
+            task.resume();
+            if (!task.done()) {continue;}
+
+            if constexpr (std::is_void_v<decltype(task.result())>) {
+                task.result();
+                on_result(slot_lookups[s]);
+            } else {
+                on_result(slot_lookups[s], task.result());
+            }
+            if (num_started < num_lookups) {
+                slot_lookups[s] = num_started;
+                task = make_task(num_started++);
+            } else {
+                task = Task{};
+                --num_in_flight;
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/* Implements `prefetching_for_each`, which calls a function on every element of an array of
+`TaggedPointer`s, like a loop over `call`, but also prefetches the objects pointed to a fixed number
+of elements ahead. When the pointed-to objects are scattered through memory, a plain loop stalls on
+a cache miss at every element; with prefetching, these misses overlap with the calls on the
+preceding elements.
+
+How much of each object to prefetch depends on its type, so the number of cache lines to prefetch
+is looked up, from the tag, in a table computed at compile-time from the sizes in
+`TaggedPointer::type_info`. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cstddef>          // For `std::size_t`
+#include <cstdint>          // For `uintptr_t`, `uint8_t`
+#include <span>             // For `std::span`
+#include <type_traits>      // For `std::remove_const_t`
+#include "tagged_pointer.h"
+
+namespace detail {
+
+/* `CACHE_LINE_SIZE` is the size, in bytes, of a cache line on all mainstream x86 and ARM CPUs. */
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/* `MAX_PREFETCH_LINES` bounds the number of cache lines prefetched per object, so that large
+objects, of which only the first few fields are likely to be read, do not flood the memory
+system. */
+constexpr std::size_t MAX_PREFETCH_LINES = 4;
+
+/* `PrefetchLines<TP>::table[tag]` is the number of cache lines to prefetch for an object pointed to
+by a `TP` with tag `tag`: `ceil(size / CACHE_LINE_SIZE)` (at most `MAX_PREFETCH_LINES`), where
+`size` is the size given by `type_info_table` (and so 0 for the null tag). */
+template <typename TP>
+struct PrefetchLines;
+
+template <typename... Ts>
+struct PrefetchLines<TaggedPointer<Ts...>> {
+    constexpr static std::array<uint8_t, sizeof...(Ts) + 1> table = [] {
+        std::array<uint8_t, sizeof...(Ts) + 1> result{};
+        for (std::size_t tag = 0; tag < result.size(); ++tag) {
+            auto size = type_info_table<Ts...>[tag].size;
+            auto lines = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+            result[tag] = static_cast<uint8_t>(lines < MAX_PREFETCH_LINES ? lines
+                                                                          : MAX_PREFETCH_LINES);
+        }
+        return result;
+    }();
+};
+
+/* Prefetches the object pointed to by `tagged_ptr`, covering as many cache lines as
+`PrefetchLines` specifies for its type. Does nothing on compilers without `__builtin_prefetch`. */
+template <typename TP>
+inline void prefetch_pointee(const TP &tagged_ptr) {
+#if defined(__GNUC__) || defined(__clang__)
+    using Lines = PrefetchLines<TaggedPointerBase_t<TP>>;
+    auto address = reinterpret_cast<const char*>(TaggedPointerAccess::bits(tagged_ptr)
+                                                 & TaggedPointerAccess::ptr_mask<TP>());
+    auto lines = Lines::table[tagged_ptr.tag()];
+    for (unsigned line = 0; line < lines; ++line) {
+        __builtin_prefetch(address + line * CACHE_LINE_SIZE);
+    }
+#else
+    (void)tagged_ptr;
+#endif
+}
+
+};  /* Ending bracket for `namespace detail` */
+
+/* `DEFAULT_PREFETCH_DISTANCE` is the default number of elements `prefetching_for_each` prefetches
+ahead. Large enough to hide a DRAM access behind calls that do a little work each. */
+constexpr std::size_t DEFAULT_PREFETCH_DISTANCE = 8;
+
+/* Calls `tagged_ptrs[i].call(func)` for every `i` in order, while prefetching the object pointed
+to by `tagged_ptrs[i + distance]`. Null elements are skipped (as by `RunIndex::for_each_run`), so
+`func` is never passed a null pointer, and need not accept one. `TP` is a `TaggedPointer` (or a type that inherits from one),
+possibly const-qualified, in which case `func` receives pointers to const; since it cannot be
+deduced from most containers, pass it explicitly, as in
+`prefetching_for_each<Shape>(my_shapes, func)`. The best `distance` depends on how long each call
+takes, and is best found by measuring. */
+template <typename TP, typename Func>
+requires detail::TaggedPointerLike<std::remove_const_t<TP>>
+void prefetching_for_each(std::span<TP> tagged_ptrs, Func &&func,
+                          std::size_t distance = DEFAULT_PREFETCH_DISTANCE) {
+    auto n = tagged_ptrs.size();
+    auto num_prefetched = n > distance ? n - distance : 0;
+    for (std::size_t i = 0; i < distance && i < n; ++i) {
+        detail::prefetch_pointee(tagged_ptrs[i]);
+    }
+    for (std::size_t i = 0; i < num_prefetched; ++i) {
+        detail::prefetch_pointee(tagged_ptrs[i + distance]);
+        if (tagged_ptrs[i].tag() != 0) {tagged_ptrs[i].call(func);}
+    }
+    for (std::size_t i = num_prefetched; i < n; ++i) {
+        if (tagged_ptrs[i].tag() != 0) {tagged_ptrs[i].call(func);}
+    }
+}
@@ -0,0 +1,108 @@
+/* Checks that every SIMD kernel of tagged_pointer_bulk.h, for every `BulkIsa` this CPU supports,
+gives exactly the same results as the corresponding scalar kernel, on random words of every length
+up to a few blocks, starting at aligned and unaligned addresses. Returns a non-zero exit status,
+after printing the first mismatch of each kind, if any kernel disagrees. */
+
+#include <algorithm>        // For `std::equal`, `std::stable_sort`
+#include <cstdint>          // For `uintptr_t`, `uint8_t`, `uint64_t`
+#include <cstdio>           // For `std::printf`
+#include <random>           // For `std::mt19937_64`
+#include <vector>           // For `std::vector`
+#include "../tagged_pointer_bulk.h"
+
+namespace {
+
+unsigned num_failures = 0;
+
+/* Records a failure of `what` with `isa` on `n` words at offset `offset`, unless `ok`. */
+void check(bool ok, const char *what, BulkIsa isa, std::size_t n, std::size_t offset) {
+    if (ok) {return;}
+    if (num_failures++ < 20) {
+        std::printf("FAIL: %s with %s, n = %zu, offset = %zu\n", what, bulk_isa_name(isa), n,
+                    offset);
+    }
+}
+
+/* Checks every kernel against its scalar version on `words[0, n)`, whose tags are all below
+`num_tags`. */
+void check_kernels(BulkIsa isa, const uintptr_t *words, std::size_t n, std::size_t offset,
+                   unsigned num_tags, std::mt19937_64 &rng) {
+    using namespace detail;
+    constexpr auto ptr_mask = TaggedPointerAccess::ptr_mask<TaggedPointer<>>();
+
+    std::vector<uint8_t> tags(n), expected_tags(n);
+    extract_tags(words, n, tags.data());
+    extract_tags_scalar(words, n, expected_tags.data());
+    check(tags == expected_tags, "extract_tags", isa, n, offset);
+
+    std::vector<uint64_t> counts(num_tags), expected_counts(num_tags);
+    count_tags(expected_tags.data(), n, counts.data(), num_tags);
+    count_tags_scalar(expected_tags.data(), n, expected_counts.data(), num_tags);
+    check(counts == expected_counts, "count_tags", isa, n, offset);
+
+    std::vector<uint64_t> histogram(num_tags);
+    tag_histogram(words, n, histogram.data(), num_tags);
+    check(histogram == expected_counts, "tag_histogram", isa, n, offset);
+
+    std::vector<uintptr_t> out(n), expected_out(n);
+    mask_words(words, n, ptr_mask, out.data());
+    mask_words_scalar(words, n, ptr_mask, expected_out.data());
+    check(out == expected_out, "mask_words", isa, n, offset);
+
+    auto tag_bits = static_cast<uintptr_t>(rng() % num_tags) << BULK_TAG_SHIFT;
+    tag_words(expected_out.data(), n, tag_bits, out.data());
+    std::vector<uintptr_t> addresses = expected_out;
+    tag_words_scalar(addresses.data(), n, tag_bits, expected_out.data());
+    check(out == expected_out, "tag_words", isa, n, offset);
+
+    /* Searches for a tag, and for a whole word, that may or may not be present. */
+    auto tag_mask = ~ptr_mask;
+    auto some_word = n > 0 && rng() % 4 != 0 ? words[rng() % n] : uintptr_t{12345};
+    for (auto [mask, value] : {std::pair{tag_mask, tag_bits}, std::pair{~uintptr_t{0}, some_word},
+                               std::pair{tag_mask, some_word & tag_mask}}) {
+        check(find_masked(words, n, mask, value) == find_masked_scalar(words, n, mask, value),
+              "find_masked", isa, n, offset);
+        check(count_masked(words, n, mask, value) == count_masked_scalar(words, n, mask, value),
+              "count_masked", isa, n, offset);
+    }
+
+    std::vector<uintptr_t> sorted(words, words + n), scratch(n);
+    partition_by_tag(sorted.data(), scratch.data(), n, expected_counts.data(), num_tags);
+    std::vector<uintptr_t> expected_sorted(words, words + n);
+    std::stable_sort(expected_sorted.begin(), expected_sorted.end(), [](auto x, auto y) {
+        return (x >> BULK_TAG_SHIFT) < (y >> BULK_TAG_SHIFT);
+    });
+    check(sorted == expected_sorted, "partition_by_tag", isa, n, offset);
+}
+
+};  /* Ending bracket for anonymous namespace */
+
+int main() {
+    constexpr std::size_t MAX_OFFSET = 3;
+    std::vector<std::size_t> sizes;
+    for (std::size_t n = 0; n <= 300; ++n) {sizes.push_back(n);}
+    for (std::size_t n : {1023, 1024, 1025, 2047, 2049, 4099, 5000}) {sizes.push_back(n);}
+
+    std::mt19937_64 rng(2024);
+    for (unsigned num_tags : {2u, 5u, detail::NUM_BULK_TAGS}) {
+        std::vector<uintptr_t> storage(sizes.back() + MAX_OFFSET);
+        for (auto &word : storage) {
+            auto address = rng() & detail::TaggedPointerAccess::ptr_mask<TaggedPointer<>>();
+            word = address | (static_cast<uintptr_t>(rng() % num_tags) << detail::BULK_TAG_SHIFT);
+        }
+        for_each_bulk_isa([&](BulkIsa isa) {
+            for (auto n : sizes) {
+                for (std::size_t offset = 0; offset <= MAX_OFFSET; ++offset) {
+                    check_kernels(isa, storage.data() + offset, n, offset, num_tags, rng);
+                }
+            }
+        });
+    }
+
+    for (auto isa : supported_bulk_isas()) {std::printf("checked %s\n", bulk_isa_name(isa));}
+    if (num_failures > 0) {
+        std::printf("%u mismatches\n", num_failures);
+        return 1;
+    }
+    return 0;
+}
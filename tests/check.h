@@ -0,0 +1,33 @@
+/* Implements the small harness shared by the assertion tests in this directory. Each test is a
+plain program that calls `check(condition, what)` for every property it tests, and returns
+`finish()` from `main`, which is a non-zero exit status iff any check failed. Unlike `assert`,
+`check` is not disabled by `NDEBUG`, which the default (Release) build defines. */
+
+#pragma once
+
+#include <cstdio>           // For `std::printf`
+#include <source_location>  // For `std::source_location`
+
+namespace test {
+
+/* `num_failures` is the number of failed checks so far. */
+inline unsigned num_failures = 0;
+
+/* Records a failure of the check described by `what`, with its location, unless `ok`. */
+inline void check(bool ok, const char *what,
+                  std::source_location where = std::source_location::current()) {
+    if (ok) {return;}
+    ++num_failures;
+    std::printf("FAIL: %s (%s:%u)\n", what, where.file_name(), static_cast<unsigned>(where.line()));
+}
+
+/* Prints a summary of the checks, and returns the exit status of the test. */
+inline int finish() {
+    if (num_failures > 0) {
+        std::printf("%u checks failed\n", num_failures);
+        return 1;
+    }
+    return 0;
+}
+
+};  /* Ending bracket for `namespace test` */
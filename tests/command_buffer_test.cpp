@@ -0,0 +1,97 @@
+/* Checks the order in which `CommandBuffer` (see command_buffer.h) replays commands: `flush`
+groups them by type and operation, and so may run different operations on the same object out of
+order, while `flush_in_order` keeps the order of all commands on objects of the same type. Also
+checks that the buffer is emptied by `clear`, by both flushes, and by an operation that throws. */
+
+#include <stdexcept>        // For `std::runtime_error`
+#include <vector>           // For `std::vector`
+#include "../command_buffer.h"
+#include "check.h"
+
+using test::check;
+
+struct A {int value;};
+struct B {int value;};
+using Pointer = TaggedPointer<A, B>;
+
+/* `trace` records the values operations leave behind, in the order in which they ran. */
+std::vector<int> trace;
+
+struct Inc {
+    template <typename T>
+    static void apply(T *object, int amount) {trace.push_back(object->value += amount);}
+};
+
+struct Mul {
+    template <typename T>
+    static void apply(T *object, int factor) {trace.push_back(object->value *= factor);}
+};
+
+struct Throw {
+    template <typename T>
+    static void apply(T*) {throw std::runtime_error("Throw");}
+};
+
+int main() {
+    A a{1};
+    B b{5};
+    CommandBuffer<Pointer, Inc, Mul> commands;
+
+    commands.record<Mul>(Pointer(&a), 10);
+    commands.record<Inc>(Pointer(&a), 1);
+    check(commands.size() == 2 && !commands.empty(), "record appends commands");
+    commands.flush_in_order();
+    check(a.value == 11 && commands.empty(), "flush_in_order runs Mul then Inc on the same object");
+
+    a.value = 1;
+    commands.record<Mul>(Pointer(&a), 10);
+    commands.record<Inc>(Pointer(&a), 1);
+    commands.flush();
+    check(a.value == 20 && commands.empty(), "flush groups Inc before Mul, reordering them");
+
+    a.value = 1;
+    trace.clear();
+    commands.record<Inc>(Pointer(&b), 1);
+    commands.record<Inc>(Pointer(&a), 1);
+    commands.record<Mul>(Pointer(&b), 2);
+    commands.record<Inc>(Pointer(&a), 2);
+    commands.record<Inc>(Pointer(&b), 3);
+    commands.flush();
+    check(trace == std::vector<int>{2, 4, 6, 9, 18}, "flush groups by type, then operation");
+
+    a.value = 1;
+    b.value = 5;
+    trace.clear();
+    commands.record<Inc>(Pointer(&b), 1);
+    commands.record<Inc>(Pointer(&a), 1);
+    commands.record<Mul>(Pointer(&b), 2);
+    commands.record<Inc>(Pointer(&a), 2);
+    commands.record<Inc>(Pointer(&b), 3);
+    commands.flush_in_order();
+    check(trace == std::vector<int>{2, 4, 6, 12, 15}, "flush_in_order groups by type only");
+
+    a.value = 1;
+    commands.record<Inc>(Pointer(&a), 100);
+    commands.clear();
+    check(commands.empty(), "clear discards the commands");
+    commands.record<Mul>(Pointer(&a), 3);
+    commands.flush();
+    check(a.value == 3, "commands recorded after clear run alone");
+
+    CommandBuffer<Pointer, Inc, Throw> throwing;
+    throwing.record<Inc>(Pointer(&a), 1);
+    throwing.record<Throw>(Pointer(&a));
+    throwing.record<Throw>(Pointer(&b));
+    bool threw = false;
+    try {
+        throwing.flush();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    check(threw && throwing.empty(), "a throwing operation still empties the buffer");
+    throwing.record<Inc>(Pointer(&a), 1);
+    throwing.flush();
+    check(a.value == 5, "the buffer is usable after an operation threw");
+
+    return test::finish();
+}
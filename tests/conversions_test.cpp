@@ -0,0 +1,53 @@
+/* Checks the conversions between `TaggedPointer`s with different type packs (see
+tagged_pointer_conversions.h): `widen` with each way of remapping tags (a copy, an addition, and a
+table lookup), and `narrow`, both succeeding and failing, including for tagged null pointers. */
+
+#include <span>             // For `std::span`
+#include "../tagged_pointer_conversions.h"
+#include "check.h"
+
+using test::check;
+
+struct A {int a;};
+struct B {int b;};
+struct C {int c;};
+
+int main() {
+    A a{1};
+    B b{2};
+    C c{3};
+
+    using AB = TaggedPointer<A, B>;
+    using ABC = TaggedPointer<A, B, C>;
+    using CAB = TaggedPointer<C, A, B>;
+    using BCA = TaggedPointer<B, C, A>;
+    using CA = TaggedPointer<C, A>;
+    static_assert(detail::TagRemap<AB, ABC>::is_affine && detail::TagRemap<AB, ABC>::offset == 0);
+    static_assert(detail::TagRemap<AB, CAB>::is_affine && detail::TagRemap<AB, CAB>::offset == 1);
+    static_assert(!detail::TagRemap<AB, BCA>::is_affine);
+
+    check(widen<ABC>(AB(&b)).cast<B>() == &b, "widen by copying the tag");
+    check(widen<CAB>(AB(&a)).cast<A>() == &a && widen<CAB>(AB(&b)).cast<B>() == &b,
+          "widen by adding to the tag");
+    check(widen<BCA>(AB(&a)).cast<A>() == &a && widen<BCA>(AB(&b)).cast<B>() == &b,
+          "widen by looking the tag up");
+    check(widen<CAB>(AB(nullptr)).tag() == 0 && widen<BCA>(AB(nullptr)).tag() == 0,
+          "widen keeps the null tag");
+
+    auto narrowed = narrow<CA>(ABC(&a));
+    check(narrowed.has_value() && narrowed->cast<A>() == &a, "narrow to a pack containing A");
+    check(narrow<CA>(ABC(&c))->cast<C>() == &c, "narrow to a pack containing C");
+    check(!narrow<CA>(ABC(&b)).has_value(), "narrow fails for a type outside the target pack");
+    check(!narrow<AB>(ABC(&c)).has_value(), "narrow fails for the last type outside the pack");
+    auto narrowed_null = narrow<CA>(ABC(nullptr));
+    check(narrowed_null.has_value() && narrowed_null->tag() == 0,
+          "narrow converts a tagged null pointer to a tagged null pointer");
+
+    const ABC from[] = {ABC(&a), ABC(&b), ABC(nullptr), ABC(&c), ABC(&b)};
+    TaggedOptional<CA> out[5];
+    check(narrow_all(std::span<const ABC>(from), out) == 3, "narrow_all counts the conversions");
+    check(out[0]->cast<A>() == &a && !out[1].has_value() && out[2]->tag() == 0
+          && out[3]->cast<C>() == &c && !out[4].has_value(), "narrow_all converts every element");
+
+    return test::finish();
+}
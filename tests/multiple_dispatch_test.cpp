@@ -0,0 +1,56 @@
+/* Checks that `dispatch` (see multiple_dispatch.h) calls `func` with the pointers of every
+argument, in order, casted to their types, and that `dispatch_symmetric` swaps its arguments iff the
+type of the first comes later in the type pack than the type of the second. */
+
+#include <type_traits>      // For `std::is_const_v`, `std::remove_pointer_t`
+#include "../multiple_dispatch.h"
+#include "check.h"
+
+using test::check;
+
+struct A {int value;};
+struct B {int value;};
+struct C {int value;};
+using Pointer = TaggedPointer<A, B, C>;
+
+/* `Ordered` is only callable with pairs of types in the order of `Pointer`'s type pack, and
+returns the values of its two arguments, in order, as a two-digit number. */
+struct Ordered {
+    template <typename T, typename U>
+    requires (Pointer::get_tag_of_type<T>() <= Pointer::get_tag_of_type<U>())
+    int operator()(const T *first, const U *second) const {
+        return first->value * 10 + second->value;
+    }
+};
+
+int main() {
+    A a{1};
+    B b{2};
+    C c{3};
+    A other_a{4};
+    Pointer pa(&a), pb(&b), pc(&c), pother_a(&other_a);
+
+    auto digits = [](auto *x, auto *y) {return x->value * 10 + y->value;};
+    check(dispatch(digits, pa, pc) == 13 && dispatch(digits, pc, pa) == 31
+          && dispatch(digits, pb, pb) == 22, "dispatch passes the arguments in order");
+    auto three_digits = [](auto *x, auto *y, auto *z) {
+        return x->value * 100 + y->value * 10 + z->value;
+    };
+    check(dispatch(three_digits, pc, pa, pb) == 312, "dispatch on three arguments");
+    const Pointer const_pb = pb;
+    check(dispatch([](auto *x, auto *y) {
+              return std::is_const_v<std::remove_pointer_t<decltype(x)>>
+                  && !std::is_const_v<std::remove_pointer_t<decltype(y)>>;
+          }, const_pb, pa), "dispatch passes pointers to const only for const arguments");
+
+    check(dispatch_symmetric(Ordered{}, pa, pc) == 13, "dispatch_symmetric keeps ordered pairs");
+    check(dispatch_symmetric(Ordered{}, pc, pa) == 13, "dispatch_symmetric swaps unordered pairs");
+    check(dispatch_symmetric(Ordered{}, pc, pb) == 23
+          && dispatch_symmetric(Ordered{}, pb, pc) == 23,
+          "dispatch_symmetric swaps only the pairs out of order");
+    check(dispatch_symmetric(Ordered{}, pa, pother_a) == 14
+          && dispatch_symmetric(Ordered{}, pother_a, pa) == 41,
+          "dispatch_symmetric keeps the order of two pointers to the same type");
+
+    return test::finish();
+}
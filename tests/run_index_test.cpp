@@ -0,0 +1,63 @@
+/* Checks that `RunIndex` (see run_index.h) finds the runs of equal tags, including runs of null
+pointers and runs longer than a block of the SIMD kernels, that `append` and `extend` merge new
+elements into the last run, and that `for_each_run` visits every run of non-null pointers, with
+the right type, in order. */
+
+#include <cstddef>          // For `std::size_t`
+#include <span>             // For `std::span`
+#include <vector>           // For `std::vector`
+#include "../run_index.h"
+#include "check.h"
+
+using test::check;
+
+struct A {int value;};
+struct B {int value;};
+using Pointer = TaggedPointer<A, B>;
+
+/* Returns whether `run` has tag `tag`, begins at `begin`, and has length `length`. */
+bool is_run(const TagRun &run, unsigned tag, std::size_t begin, std::size_t length) {
+    return run.tag == tag && run.begin == begin && run.length == length;
+}
+
+int main() {
+    A a{1};
+    B b{10};
+    constexpr std::size_t LONG = 3 * detail::BULK_BLOCK_SIZE + 5;
+
+    std::vector<Pointer> ptrs;
+    ptrs.insert(ptrs.end(), 3, Pointer(&a));
+    ptrs.insert(ptrs.end(), 2, Pointer(nullptr));
+    ptrs.insert(ptrs.end(), LONG, Pointer(&b));
+    ptrs.insert(ptrs.end(), 1, Pointer(&a));
+    ptrs.insert(ptrs.end(), 9, Pointer(nullptr));
+
+    RunIndex<Pointer> index{std::span<const Pointer>(ptrs)};
+    auto &runs = index.runs();
+    check(index.size() == ptrs.size(), "size() is the number of indexed elements");
+    check(runs.size() == 5, "every change of tag starts a run");
+    check(runs.size() == 5 && is_run(runs[0], 1, 0, 3) && is_run(runs[1], 0, 3, 2)
+          && is_run(runs[2], 2, 5, LONG) && is_run(runs[3], 1, 5 + LONG, 1)
+          && is_run(runs[4], 0, 6 + LONG, 9), "runs, including null runs and runs across blocks");
+
+    ptrs.push_back(Pointer(nullptr));
+    index.append(ptrs.back());
+    check(runs.size() == 5 && runs[4].length == 10, "append merges into the last run");
+    ptrs.insert(ptrs.end(), 4, Pointer(&b));
+    index.extend(std::span<const Pointer>(ptrs).last(4));
+    check(runs.size() == 6 && is_run(runs[5], 2, 16 + LONG, 4), "extend starts a new run");
+
+    std::vector<int> visited;
+    int sum = 0;
+    index.for_each_run(std::span<Pointer>(ptrs), [&](auto run) {
+        visited.push_back(run[0]->value);
+        for (auto *ptr : run) {sum += ptr->value;}
+    });
+    check(visited == std::vector<int>{1, 10, 1, 10}, "for_each_run skips the null runs");
+    check(sum == 3 + 10 * static_cast<int>(LONG) + 1 + 40, "for_each_run visits every element");
+
+    index.clear();
+    check(index.size() == 0 && index.runs().empty(), "clear empties the index");
+
+    return test::finish();
+}
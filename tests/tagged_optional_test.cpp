@@ -0,0 +1,65 @@
+/* Checks the states of `TaggedOptional` and `TaggedResult` (see tagged_optional.h): empty, holding
+a value (including a tagged null pointer, which is not empty), and holding an error code, including
+negative ones, which must not spill into the tag bits. */
+
+#include <optional>         // For `std::nullopt`, `std::bad_optional_access`
+#include "../tagged_optional.h"
+#include "check.h"
+
+using test::check;
+
+struct A {int a;};
+struct B {int b;};
+using Pointer = TaggedPointer<A, B>;
+
+enum class Error : int {NotFound = 1, Negative = -7};
+
+int main() {
+    A a{1};
+    B b{2};
+
+    static_assert(sizeof(TaggedOptional<Pointer>) == sizeof(Pointer));
+    static_assert(sizeof(TaggedResult<Pointer, Error>) == sizeof(Pointer));
+
+    TaggedOptional<Pointer> empty;
+    check(!empty.has_value() && !empty, "a default-constructed TaggedOptional is empty");
+    check(empty == TaggedOptional<Pointer>(std::nullopt), "empty TaggedOptionals are equal");
+    check(empty.value_or(Pointer(&b)).cast<B>() == &b, "value_or of an empty TaggedOptional");
+    bool threw = false;
+    try {
+        (void)empty.value();
+    } catch (const std::bad_optional_access&) {
+        threw = true;
+    }
+    check(threw, "value() of an empty TaggedOptional throws");
+
+    TaggedOptional<Pointer> holding_a{Pointer(&a)};
+    check(holding_a.has_value() && holding_a->cast<A>() == &a, "TaggedOptional holding an A");
+    check(holding_a != empty, "a TaggedOptional holding a value differs from an empty one");
+    holding_a.reset();
+    check(!holding_a.has_value() && holding_a == empty, "reset empties a TaggedOptional");
+
+    TaggedOptional<Pointer> holding_null{Pointer(nullptr)};
+    check(holding_null.has_value(), "a TaggedOptional holding a tagged null pointer is not empty");
+    check(holding_null->tag() == 0, "the held tagged null pointer has the null tag");
+
+    auto ok = TaggedResult<Pointer, Error>(Pointer(&b));
+    check(ok.has_value() && ok->cast<B>() == &b, "TaggedResult holding a B");
+
+    auto not_found = TaggedResult<Pointer, Error>::from_error(Error::NotFound);
+    check(!not_found.has_value() && not_found.error() == Error::NotFound,
+          "TaggedResult holding an error");
+    check(not_found.value_or(Pointer(&a)).cast<A>() == &a, "value_or of a TaggedResult error");
+
+    auto negative = TaggedResult<Pointer, Error>::from_error(Error::Negative);
+    check(!negative.has_value() && negative.error() == Error::Negative,
+          "TaggedResult holding a negative error");
+    check(negative != not_found, "TaggedResults holding different errors differ");
+
+    auto int_error = TaggedResult<Pointer, int>::from_error(-1);
+    check(!int_error.has_value() && int_error.error() == -1, "TaggedResult with an int error");
+    check(TaggedResult<Pointer, int>::from_error(0) != TaggedResult<Pointer, int>(Pointer(nullptr)),
+          "error 0 differs from a tagged null pointer");
+
+    return test::finish();
+}
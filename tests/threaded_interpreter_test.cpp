@@ -0,0 +1,75 @@
+/* Checks that `run_threaded` (see threaded_interpreter.h) runs the instructions of a program in
+order, follows the jumps `func` returns, and stops past the end of the program or at a tagged null
+pointer, both with and without a `state` passed through the handlers. CMakeLists.txt builds this
+file twice: with the default computed `goto`s, and with `TAGGED_POINTER_NO_COMPUTED_GOTO`. */
+
+#include <cstddef>          // For `std::size_t`
+#include <span>             // For `std::span`
+#include <vector>           // For `std::vector`
+#include "../threaded_interpreter.h"
+#include "check.h"
+
+using test::check;
+
+/* `Push` appends its value to the trace, and continues at `next` when `func` returns an index.
+`Loop` jumps back to `target` `count` times, and then continues at `next`. `Skip` does nothing. */
+struct Push {int value; std::size_t next;};
+struct Loop {std::size_t target, next; int count;};
+struct Skip {};
+using Instruction = TaggedPointer<Push, Loop, Skip>;
+
+int main() {
+    Push p1{1, 2}, p2{2, 3}, p3{3, 100}, p9{9, 0};
+    Loop loop{2, 4, 2};
+    Skip skip;
+
+    std::vector<int> trace;
+    auto append = [&](auto op) {
+        if constexpr (requires {op->value;}) {trace.push_back(op->value);}
+    };
+    const Instruction straight[] = {Instruction(&p1), Instruction(&skip), Instruction(&p2),
+                                    Instruction(&p3)};
+    run_threaded<const Instruction>(std::span(straight), append);
+    check(trace == std::vector<int>{1, 2, 3}, "instructions run in order up to the end");
+
+    trace.clear();
+    run_threaded<const Instruction>(std::span(straight), append, 2);
+    check(trace == std::vector<int>{2, 3}, "the program starts at `start`");
+
+    trace.clear();
+    run_threaded<const Instruction>(std::span(straight), append, 4);
+    check(trace.empty(), "a program starting at its end runs nothing");
+
+    trace.clear();
+    const Instruction halting[] = {Instruction(&p1), Instruction(&p2), Instruction(nullptr),
+                                   Instruction(&p3)};
+    run_threaded<const Instruction>(std::span(halting), append);
+    check(trace == std::vector<int>{1, 2}, "a tagged null pointer halts the program");
+
+    trace.clear();
+    auto jump = [&](auto op) -> std::size_t {
+        if constexpr (requires {op->value;}) {
+            trace.push_back(op->value);
+            return op->next;
+        } else if constexpr (requires {op->count;}) {
+            return op->count-- > 0 ? op->target : op->next;
+        } else {
+            return 0;
+        }
+    };
+    /* Runs 1, skips 9, runs 2 three times through the loop, then 3, which jumps past the end. */
+    Instruction jumping[] = {Instruction(&p1), Instruction(&p9), Instruction(&p2),
+                             Instruction(&loop), Instruction(&p3), Instruction(&p9)};
+    run_threaded<Instruction>(std::span(jumping), jump);
+    check(trace == std::vector<int>{1, 2, 2, 2, 3}, "jumps returned by `func` are followed");
+
+    auto digits = [](auto op, int &acc) {
+        if constexpr (requires {op->value;}) {acc = acc * 10 + op->value;}
+    };
+    check(run_threaded<const Instruction>(std::span(straight), 0, digits) == 123,
+          "the state is passed from each instruction to the next");
+    check(run_threaded<const Instruction>(std::span(halting), 0, digits, 1) == 2,
+          "the state is returned when a tagged null pointer halts the program");
+
+    return test::finish();
+}
@@ -0,0 +1,241 @@
+/* Implements `run_threaded`, which runs a program made of an array of `TaggedPointer`s, each
+pointing to an instruction object whose type is its opcode, as threaded code. A loop of `call`s
+funnels every instruction through the same indirect branch (or `switch`), which the branch
+predictor can only predict from the history of that single branch. In threaded code, every handler
+instead ends with its own copy of the dispatch to the next instruction, so that each handler has
+its own indirect branch, and the predictor learns which opcode tends to follow which.
+
+On GCC and Clang, the handlers are the arms of a single function body, one per tag, each ending
+with a computed `goto` (labels as values) to the arm of the next instruction's tag. As there are at
+most `max_tag() + 1 = 32` tags, the body spells out 32 labels, of which those past the tags of
+`Ts...` are compiled to nothing with `if constexpr`. Define `TAGGED_POINTER_NO_COMPUTED_GOTO` to
+use one of the fallbacks below instead.
+
+Otherwise, the handler for each type is a thunk, generated at compile-time, calling `func` on the
+typed pointer. The thunks are gathered in a table indexed by tag; each thunk looks up the tag of
+the next instruction and calls the next thunk as a guaranteed tail call (with `[[clang::musttail]]`
+or `[[gnu::musttail]]`), so the stack does not grow with the number of instructions executed. On
+compilers with neither computed `goto`s nor guaranteed tail calls, each thunk instead returns the
+index of the next instruction to a trampoline loop, which is correct but loses the replicated
+dispatch.
+
+As the handlers cannot be inlined into the caller of `run_threaded` (GCC never inlines a function
+containing a computed `goto`), state the handlers capture by reference lives in memory, and is
+loaded and stored again by every instruction. The overload of `run_threaded` taking a `state`
+instead passes it by value through the handlers, where it stays in registers. */
+
+#pragma once
+
+#include <array>            // For `std::array`
+#include <cstddef>          // For `std::size_t`
+#include <span>             // For `std::span`
+#include <tuple>            // For `std::tuple`, `std::tuple_element_t`
+#include <type_traits>      // For `std::remove_const_t`, `std::is_void_v`, `std::is_invocable_v`
+#include <utility>          // For `std::move`
+#include "tagged_pointer.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(TAGGED_POINTER_NO_COMPUTED_GOTO)
+#define TAGGED_POINTER_COMPUTED_GOTO
+#elif defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define TAGGED_POINTER_MUSTTAIL [[clang::musttail]]
+#elif __has_cpp_attribute(gnu::musttail)
+#define TAGGED_POINTER_MUSTTAIL [[gnu::musttail]]
+#endif
+#endif
+
+namespace detail {
+
+/* `NoThreadedState` is the state of a `run_threaded` whose handlers carry none. */
+struct NoThreadedState {};
+
+/* `IsThreadedStateHandler<Func, TP, State>` is `true` iff `func` can be called with a pointer to
+the first type `TP` can point to and a `State&`, as the handlers of the overload of `run_threaded`
+taking a `state` are. This tells that overload apart from the one taking a `start` index. */
+template <typename Func, typename TP, typename State,
+          typename Base = TaggedPointerBase_t<std::remove_const_t<TP>>>
+constexpr bool IsThreadedStateHandler = false;
+
+template <typename Func, typename TP, typename State, typename T, typename... Ts>
+constexpr bool IsThreadedStateHandler<Func, TP, State, TaggedPointer<T, Ts...>>
+    = std::is_invocable_v<Func&, std::conditional_t<std::is_const_v<TP>, const T, T>*, State&>;
+
+/* `ThreadedContext<TP, Func>` holds what every thunk of `run_threaded` needs: the function to
+call, and the program. */
+template <typename TP, typename Func>
+struct ThreadedContext {
+    Func &func;
+    TP *program;
+    std::size_t size;
+};
+
+/* `ThreadedCode<TP, Func, State>::run(context, pc, state)` runs the program from index `pc`, and
+returns the final `state`. Each handler calls `func` with the instruction at index `pc`, casted to
+its type (and with `state`, unless `State` is `NoThreadedState`), and continues at the index
+`func` returned (or at `pc + 1`, if it returned nothing). The handler for the null tag ends the
+program. With the thunk fallbacks, `table[tag]` points to the thunk handling instructions with tag
+`tag`. */
+template <typename TP, typename Func, typename State,
+          typename Base = TaggedPointerBase_t<std::remove_const_t<TP>>>
+struct ThreadedCode;
+
+template <typename TP, typename Func, typename State, typename... Ts>
+struct ThreadedCode<TP, Func, State, TaggedPointer<Ts...>> {
+    using Context = ThreadedContext<TP, Func>;
+    using Base = TaggedPointer<Ts...>;
+    using VoidPtr = std::conditional_t<std::is_const_v<TP>, const void*, void*>;
+
+    /* Calls `func` on `typed_ptr` (and `state`), and returns what it returns. */
+    template <typename T>
+    static decltype(auto) handle(Func &func, T *typed_ptr, State &state) {
+        if constexpr (std::is_same_v<State, NoThreadedState>) {
+            return func(typed_ptr);
+        } else {
+            return func(typed_ptr, state);
+        }
+    }
+
+    /* Runs the instruction at index `pc` of `program`, which points to a `T`, and returns the
+    index of the next instruction. */
+    template <typename T>
+    static std::size_t step(Func &func, TP *program, std::size_t pc, State &state) {
+#ifdef TAGGED_POINTER_INSTRUMENT
+        DispatchProbe probe(dispatch_site<std::remove_cvref_t<Func>, Ts...>(),
+                            IndexOfType_v<T, Ts...>);
+#endif
+        auto bits = TaggedPointerAccess::bits(program[pc]);
+        auto ptr = reinterpret_cast<VoidPtr>(bits & TaggedPointerAccess::ptr_mask<Base>());
+        auto typed_ptr = static_cast<CopyConst_t<VoidPtr, T>*>(ptr);
+        if constexpr (std::is_void_v<decltype(handle(func, typed_ptr, state))>) {
+            handle(func, typed_ptr, state);
+            return pc + 1;
+        } else {
+            return static_cast<std::size_t>(handle(func, typed_ptr, state));
+        }
+    }
+
+#ifdef TAGGED_POINTER_COMPUTED_GOTO
+    /* `TypeOfTag<I>` is the type with tag `I`, for `I > 0`. */
+    template <std::size_t I>
+    using TypeOfTag = std::tuple_element_t<I - 1, std::tuple<Ts...>>;
+
+    /* `label_I` is the handler for tag `I`. A handler past the last tag is empty, and never jumped
+    to. */
+#define TAGGED_POINTER_THREADED_HANDLER(I)                          \
+    label_##I:                                                      \
+    if constexpr (I == 0) {                                         \
+        return state;                                               \
+    } else if constexpr (I <= sizeof...(Ts)) {                      \
+        pc = step<TypeOfTag<I>>(func, program, pc, state);          \
+        if (pc >= size) {return state;}                             \
+        goto *labels[program[pc].tag()];                            \
+    }
+
+    /* The members of `context` are copied into locals, so that they stay in registers rather
+    than being loaded again after every call to `func`. */
+    static State run(Context context, std::size_t pc, State state) {
+        static_assert(sizeof...(Ts) < 32, "A `TaggedPointer` has at most 32 tags");
+        auto &func = context.func;
+        auto *program = context.program;
+        auto size = context.size;
+        static void *const labels[32] = {
+            &&label_0, &&label_1, &&label_2, &&label_3, &&label_4, &&label_5, &&label_6,
+            &&label_7, &&label_8, &&label_9, &&label_10, &&label_11, &&label_12, &&label_13,
+            &&label_14, &&label_15, &&label_16, &&label_17, &&label_18, &&label_19, &&label_20,
+            &&label_21, &&label_22, &&label_23, &&label_24, &&label_25, &&label_26, &&label_27,
+            &&label_28, &&label_29, &&label_30, &&label_31
+        };
+        if (pc >= size) {return state;}
+        goto *labels[program[pc].tag()];
+
+        TAGGED_POINTER_THREADED_HANDLER(0)  TAGGED_POINTER_THREADED_HANDLER(1)
+        TAGGED_POINTER_THREADED_HANDLER(2)  TAGGED_POINTER_THREADED_HANDLER(3)
+        TAGGED_POINTER_THREADED_HANDLER(4)  TAGGED_POINTER_THREADED_HANDLER(5)
+        TAGGED_POINTER_THREADED_HANDLER(6)  TAGGED_POINTER_THREADED_HANDLER(7)
+        TAGGED_POINTER_THREADED_HANDLER(8)  TAGGED_POINTER_THREADED_HANDLER(9)
+        TAGGED_POINTER_THREADED_HANDLER(10) TAGGED_POINTER_THREADED_HANDLER(11)
+        TAGGED_POINTER_THREADED_HANDLER(12) TAGGED_POINTER_THREADED_HANDLER(13)
+        TAGGED_POINTER_THREADED_HANDLER(14) TAGGED_POINTER_THREADED_HANDLER(15)
+        TAGGED_POINTER_THREADED_HANDLER(16) TAGGED_POINTER_THREADED_HANDLER(17)
+        TAGGED_POINTER_THREADED_HANDLER(18) TAGGED_POINTER_THREADED_HANDLER(19)
+        TAGGED_POINTER_THREADED_HANDLER(20) TAGGED_POINTER_THREADED_HANDLER(21)
+        TAGGED_POINTER_THREADED_HANDLER(22) TAGGED_POINTER_THREADED_HANDLER(23)
+        TAGGED_POINTER_THREADED_HANDLER(24) TAGGED_POINTER_THREADED_HANDLER(25)
+        TAGGED_POINTER_THREADED_HANDLER(26) TAGGED_POINTER_THREADED_HANDLER(27)
+        TAGGED_POINTER_THREADED_HANDLER(28) TAGGED_POINTER_THREADED_HANDLER(29)
+        TAGGED_POINTER_THREADED_HANDLER(30) TAGGED_POINTER_THREADED_HANDLER(31)
+        return state;  /* Never reached: the labels past the tags of `Ts...` are never jumped to. */
+    }
+
+#undef TAGGED_POINTER_THREADED_HANDLER
+#elif defined(TAGGED_POINTER_MUSTTAIL)
+    using Thunk = State (*)(Context&, std::size_t, State);
+
+    static State halt(Context&, std::size_t, State state) {return state;}
+
+    template <typename T>
+    static State thunk(Context &context, std::size_t pc, State state) {
+        auto next = step<T>(context.func, context.program, pc, state);
+        if (next >= context.size) {return state;}
+        TAGGED_POINTER_MUSTTAIL return table[context.program[next].tag()](context, next, state);
+    }
+#else
+    using Thunk = std::size_t (*)(Context&, std::size_t, State&);
+
+    static std::size_t halt(Context &context, std::size_t, State&) {return context.size;}
+
+    template <typename T>
+    static std::size_t thunk(Context &context, std::size_t pc, State &state) {
+        return step<T>(context.func, context.program, pc, state);
+    }
+#endif
+
+#ifndef TAGGED_POINTER_COMPUTED_GOTO
+    constexpr static std::array<Thunk, sizeof...(Ts) + 1> table = {&halt, &thunk<Ts>...};
+
+    static State run(Context context, std::size_t pc, State state) {
+#ifdef TAGGED_POINTER_MUSTTAIL
+        if (pc >= context.size) {return state;}
+        return table[context.program[pc].tag()](context, pc, state);
+#else
+        while (pc < context.size) {pc = table[context.program[pc].tag()](context, pc, state);}
+        return state;
+#endif
+    }
+#endif
+};
+
+};  /* Ending bracket for `namespace detail` */
+
+/* Runs `program` as threaded code, starting at index `start`: calls `func(typed_ptr)`, where
+`typed_ptr` is the pointer stored in the current instruction, casted to its correct type (pointing
+to const iff `TP` is const), and moves to the next instruction. If `func` returns nothing, the
+next instruction is the following one; otherwise, `func` returns its index (which allows jumps).
+The program ends when the next index is past the end of `program`, or when the instruction there is
+a tagged null pointer.
+
+`TP` is a `TaggedPointer` (or a type that inherits from one), possibly const-qualified; since it
+cannot be deduced from most containers, pass it explicitly, as in
+`run_threaded<const Instruction>(my_program, func)`. */
+template <typename TP, typename Func>
+requires detail::TaggedPointerLike<std::remove_const_t<TP>>
+void run_threaded(std::span<TP> program, Func &&func, std::size_t start = 0) {
+    using Code = detail::ThreadedCode<TP, std::remove_reference_t<Func>, detail::NoThreadedState>;
+    Code::run({func, program.data(), program.size()}, start, {});
+}
+
+/* Same as the overload above, but calls `func(typed_ptr, state)`, where `state` is a `State&`
+that starts as a copy of `state` and is passed from each instruction to the next, and returns its
+final value. Prefer this to a `func` capturing its state by reference, as in
+`run_threaded<const Instruction>(my_program, 0L, [](auto op, long &acc) {acc += op->value;})`:
+the state is then kept in registers instead of in memory (see the top of this file). */
+template <typename TP, typename State, typename Func>
+requires detail::TaggedPointerLike<std::remove_const_t<TP>>
+      && detail::IsThreadedStateHandler<std::remove_reference_t<Func>, TP, State>
+State run_threaded(std::span<TP> program, State state, Func &&func, std::size_t start = 0) {
+    using Code = detail::ThreadedCode<TP, std::remove_reference_t<Func>, State>;
+    return Code::run({func, program.data(), program.size()}, start, std::move(state));
+}
+
+#undef TAGGED_POINTER_COMPUTED_GOTO
+#undef TAGGED_POINTER_MUSTTAIL